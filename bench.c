@@ -0,0 +1,374 @@
+// Benchmark for the rc522c API, without the Python layer in the way.
+//
+// Build (drop transport_pigpio.c, -lpigpio and add -DRC522C_NO_PIGPIO on machines without pigpio):
+//   cc -O2 -o rc522c-bench bench.c rc522c.c transport_pigpio.c transport_spidev.c emu.c crc.c -lpigpio -lpthread
+//
+// Run against the emulator, or a reader wired as in examples/usage.py:
+//   ./rc522c-bench -t emulator -n 1000
+//   sudo ./rc522c-bench -t pigpio -r 25 -i 24 -o select,read_range
+//
+// Every operation is run n times on the tag in the field. One JSON object per operation is printed to stdout:
+// latency percentiles, throughput, and how many tag commands and SPI transactions an operation takes.
+// write and protect change the tag: write stores the same 4 bytes to one page over and over, protect sets the
+// password to FF FF FF FF and AUTH0 to 0xFF (protection disabled), which are the factory defaults.
+
+#include "rc522c.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum bench_op
+{
+  BENCH_SELECT,
+  BENCH_RESELECT,
+  BENCH_READ,
+  BENCH_READ_RANGE,
+  BENCH_WRITE,
+  BENCH_AUTH,
+  BENCH_PROTECT,
+  BENCH_OP_COUNT
+};
+
+static const char* const op_names[BENCH_OP_COUNT] = {
+    "select", "reselect", "read", "read_range", "write", "auth", "protect"};
+
+static const char* const transport_names[] = {"pigpio", "spidev", "emulator"};
+
+static const char default_pwd[RC522_PWD_LEN] = {(char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF};
+static const char default_pack[RC522_PACK_LEN] = {0, 0};
+
+struct bench_options
+{
+    struct rc522c_config cfg;
+    int iterations;
+    int page;
+    int ops[BENCH_OP_COUNT];
+};
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int is_tag_error(enum rc522c_status status)
+{
+    return status == RC522C_STATUS_ERROR_TAG_MISSING || status == RC522C_STATUS_ERROR_TAG_UNSUPPORTED ||
+           status == RC522C_STATUS_ERROR_TAG_NAK || status == RC522C_STATUS_ERROR_TAG_COLLISION;
+}
+
+static void print_error(const char* what, struct rc522c_state* s, enum rc522c_status status)
+{
+    fprintf(stderr, "%s: status %d, error code %d (%s:%d)\n", what, status, s->error_code, s->error_file,
+        s->error_line);
+}
+
+static enum rc522c_status run_op(struct rc522c_state* s, enum bench_op op, int page)
+{
+    char buf[NTAG_MAX_PAGES * 4];
+    switch (op)
+    {
+    case BENCH_SELECT:
+        return rc522c_ntag_select(s);
+    case BENCH_RESELECT:
+        return rc522c_ntag_reselect(s);
+    case BENCH_READ:
+        return rc522c_ntag_read(s, page, buf);
+    case BENCH_READ_RANGE:
+        return rc522c_ntag_read_range(s, 0, rc522c_ntag_page_count(s->tag_kind) - 1, buf);
+    case BENCH_WRITE:
+        return rc522c_ntag_write(s, page, "\xCA\xFE\xB0\xBA");
+    case BENCH_AUTH:
+        return rc522c_ntag_authenticate(s, default_pwd, buf);
+    case BENCH_PROTECT:
+        return rc522c_ntag_protect(s, default_pwd, default_pack, 0xFF, 0);
+    default:
+        return RC522C_STATUS_SUCCESS;
+    }
+}
+
+// REQA and WUPA are ignored by a tag that is already selected. To measure a selection from IDLE, the tag is sent
+// there first: a READ past the end of the memory is NAKed, and a NAK returns NTAG21x to IDLE (section 8.4). The
+// driver keeps the tag known, so that rc522c_ntag_reselect can still be used.
+static void return_to_idle(struct rc522c_state* s)
+{
+    char buf[RC522_READ_LEN];
+    rc522c_ntag_read(s, (char)0xFF, buf);
+}
+
+// Adds the counters of the last timed operation to the totals
+static void add_stats(struct rc522c_stats* total, const struct rc522c_stats* stats)
+{
+    for (int cmd = 0; cmd < RC522C_STATS_CMD_COUNT; cmd++)
+    {
+        struct rc522c_cmd_stats* t = &total->cmds[cmd];
+        const struct rc522c_cmd_stats* c = &stats->cmds[cmd];
+        t->count += c->count;
+        t->spi_xfers += c->spi_xfers;
+        t->polls += c->polls;
+        t->timeouts += c->timeouts;
+        t->total_us += c->total_us;
+        if (c->max_us > t->max_us)
+            t->max_us = c->max_us;
+    }
+}
+
+static int compare_ll(const void* a, const void* b)
+{
+    long long x = *(const long long*)a, y = *(const long long*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile_us(const long long* sorted_ns, int n, int p)
+{
+    int rank = (p * n + 99) / 100;
+    return sorted_ns[rank > 0 ? rank - 1 : 0] / 1000.0;
+}
+
+// Runs op the given number of times, printing a JSON object with the results. Returns 0 on success, -1 if a device
+// error stopped the benchmark.
+static int bench_op(struct rc522c_state* s, const struct bench_options* opts, enum bench_op op)
+{
+    int n = opts->iterations;
+    long long* samples = malloc(sizeof(long long) * n);
+    if (!samples)
+    {
+        perror("malloc");
+        return -1;
+    }
+
+    enum rc522c_status status;
+    int ok = 0, tag_errors = 0;
+    // Counters and time spent in the measured operations only, without the preparation and recovery steps
+    struct rc522c_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    unsigned int spi_xfers = 0;
+    long long elapsed = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        if (op == BENCH_SELECT || op == BENCH_RESELECT)
+            return_to_idle(s);
+
+        rc522c_stats_reset(s);
+        unsigned int spi_xfer_start = s->spi_xfer_count;
+        long long t = now_ns();
+        status = run_op(s, op, opts->page);
+        samples[ok] = now_ns() - t;
+        elapsed += samples[ok];
+        spi_xfers += s->spi_xfer_count - spi_xfer_start;
+        add_stats(&stats, &s->stats);
+
+        if (status == RC522C_STATUS_SUCCESS)
+        {
+            ok++;
+            continue;
+        }
+        if (!is_tag_error(status))
+            goto device_error;
+
+        // The tag went back to IDLE (or left the field for a moment): select it again, outside of the measurements
+        tag_errors++;
+        rc522c_ntag_select(s);
+    }
+
+    unsigned int tag_cmds = 0;
+    for (int cmd = 0; cmd < RC522C_STATS_CMD_COUNT; cmd++)
+        tag_cmds += stats.cmds[cmd].count;
+
+    printf("{\"op\": \"%s\", \"transport\": \"%s\", \"spi_baud_rate\": %d, \"hw_crc\": %d, \"iterations\": %d, "
+           "\"ok\": %d, \"tag_errors\": %d, \"elapsed_s\": %.6f, \"ops_per_s\": %.1f",
+        op_names[op], transport_names[opts->cfg.transport], s->spi_baud_rate, opts->cfg.hw_crc, n, ok, tag_errors,
+        elapsed / 1e9, elapsed > 0 ? n * 1e9 / elapsed : 0.0);
+    if (ok > 0)
+    {
+        qsort(samples, ok, sizeof(long long), compare_ll);
+        long long sum = 0;
+        for (int i = 0; i < ok; i++)
+            sum += samples[i];
+        printf(", \"mean_us\": %.1f, \"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f",
+            sum / 1000.0 / ok, percentile_us(samples, ok, 50), percentile_us(samples, ok, 90),
+            percentile_us(samples, ok, 99), samples[ok - 1] / 1000.0);
+    }
+    printf(", \"tag_cmds_per_op\": %.2f, \"spi_xfers_per_op\": %.2f, \"spi_xfers_per_cmd\": %.2f, \"commands\": {",
+        (double)tag_cmds / n, (double)spi_xfers / n, tag_cmds ? (double)spi_xfers / tag_cmds : 0.0);
+    int first = 1;
+    for (int cmd = 0; cmd < RC522C_STATS_CMD_COUNT; cmd++)
+    {
+        const struct rc522c_cmd_stats* c = &stats.cmds[cmd];
+        if (!c->count)
+            continue;
+        printf("%s\"%s\": {\"count\": %u, \"spi_xfers\": %u, \"polls\": %u, \"timeouts\": %u, \"mean_us\": %.1f, "
+               "\"max_us\": %u}",
+            first ? "" : ", ", rc522c_stats_cmd_name(cmd), c->count, c->spi_xfers, c->polls, c->timeouts,
+            (double)c->total_us / c->count, c->max_us);
+        first = 0;
+    }
+    printf("}}\n");
+    fflush(stdout);
+
+    free(samples);
+    return 0;
+
+device_error:
+    print_error(op_names[op], s, status);
+    free(samples);
+    return -1;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -t TRANSPORT  pigpio, spidev or emulator (default: pigpio, or spidev if built without pigpio)\n"
+        "  -n N          iterations per operation (default: 100)\n"
+        "  -o OPS        comma-separated operations (default: all of them):\n"
+        "                select, reselect, read, read_range, write, auth, protect\n"
+        "  -p PAGE       page used by read and write (default: 6)\n"
+        "  -b BAUD       SPI baud rate, 0 to tune it automatically (default: 1000000)\n"
+        "  -g GAIN       antenna gain, 0...7 (default: 4)\n"
+        "  -r PIN        RST pin (default: 25)\n"
+        "  -i PIN        IRQ pin (default: not connected)\n"
+        "  -c CHANNEL    SPI chip select (default: 0)\n"
+        "  -a            use the auxiliary SPI bus\n"
+        "  -d DEVICE     spidev device (default: /dev/spidevB.C, B = -a, C = -c)\n"
+        "  -C            compute CRC_A on the MFRC522 (hw_crc)\n",
+        argv0);
+}
+
+static int parse_ops(char* list, int* ops)
+{
+    memset(ops, 0, sizeof(int) * BENCH_OP_COUNT);
+    for (char* name = strtok(list, ","); name; name = strtok(NULL, ","))
+    {
+        int op = 0;
+        while (op < BENCH_OP_COUNT && strcmp(name, op_names[op]) != 0)
+            op++;
+        if (op == BENCH_OP_COUNT)
+        {
+            fprintf(stderr, "Unknown operation: %s\n", name);
+            return -1;
+        }
+        ops[op] = 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    struct bench_options opts;
+    memset(&opts, 0, sizeof(opts));
+#ifdef RC522C_NO_PIGPIO
+    opts.cfg.transport = RC522C_TRANSPORT_SPIDEV;
+#else
+    opts.cfg.transport = RC522C_TRANSPORT_PIGPIO;
+#endif
+    opts.cfg.spi_baud_rate = 1000000;
+    opts.cfg.antenna_gain = 4;
+    opts.cfg.rst_pin = 25;
+    opts.cfg.irq_pin = -1;
+    opts.iterations = 100;
+    opts.page = 6;
+    for (int op = 0; op < BENCH_OP_COUNT; op++)
+        opts.ops[op] = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:o:p:b:g:r:i:c:ad:Ch")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            if (strcmp(optarg, "pigpio") == 0)
+                opts.cfg.transport = RC522C_TRANSPORT_PIGPIO;
+            else if (strcmp(optarg, "spidev") == 0)
+                opts.cfg.transport = RC522C_TRANSPORT_SPIDEV;
+            else if (strcmp(optarg, "emulator") == 0)
+                opts.cfg.transport = RC522C_TRANSPORT_EMULATOR;
+            else
+            {
+                fprintf(stderr, "Unknown transport: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'n':
+            opts.iterations = atoi(optarg);
+            break;
+        case 'o':
+            if (parse_ops(optarg, opts.ops) < 0)
+                return 2;
+            break;
+        case 'p':
+            opts.page = atoi(optarg);
+            break;
+        case 'b':
+            opts.cfg.spi_baud_rate = atoi(optarg);
+            break;
+        case 'g':
+            opts.cfg.antenna_gain = atoi(optarg);
+            break;
+        case 'r':
+            opts.cfg.rst_pin = atoi(optarg);
+            break;
+        case 'i':
+            opts.cfg.irq_pin = atoi(optarg);
+            break;
+        case 'c':
+            opts.cfg.spi_channel = atoi(optarg);
+            break;
+        case 'a':
+            opts.cfg.spi_aux = 1;
+            break;
+        case 'd':
+            opts.cfg.spi_device = optarg;
+            break;
+        case 'C':
+            opts.cfg.hw_crc = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opts.iterations < 1 || opts.cfg.spi_baud_rate < 0 || opts.cfg.antenna_gain < 0 || opts.cfg.antenna_gain > 7 || opts.page < 0 ||
+        opts.page > 0xFF)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    struct rc522c_state s;
+    enum rc522c_status status = rc522c_init(&s, &opts.cfg);
+    if (status != RC522C_STATUS_SUCCESS)
+    {
+        print_error("init", &s, status);
+        rc522c_deinit(&s);
+        return 1;
+    }
+
+    // Wait for a tag to show up, for up to 10 seconds
+    long long deadline = now_ns() + 10000000000LL;
+    while ((status = rc522c_ntag_select(&s)) != RC522C_STATUS_SUCCESS)
+    {
+        if (!is_tag_error(status) || now_ns() > deadline)
+        {
+            print_error("no tag in the field", &s, status);
+            rc522c_deinit(&s);
+            return 1;
+        }
+    }
+
+    int ret = 0;
+    for (int op = 0; op < BENCH_OP_COUNT && ret == 0; op++)
+    {
+        if (opts.ops[op])
+            ret = bench_op(&s, &opts, op);
+    }
+
+    rc522c_deinit(&s);
+    return ret == 0 ? 0 : 1;
+}
@@ -1,27 +1,24 @@
+#include <stdint.h>
+
 #include "crc.h"
 
-void init_crc16_ccitt(struct crc16_ccitt* s)
-{
-    uint16_t polynomial = 0x8408;
-    for (int i = 0; i < 256; ++i)
-    {
-        uint16_t crc = i;
-        for (int j = 8; j > 0; j--)
-        {
-            if (crc & 1)
-                crc = (crc >> 1) ^ polynomial;
-            else
-                crc >>= 1;
-        }
-        s->lut[i] = crc;
-    }
-}
+#define CRC_POLYNOMIAL 0x8408
+
+// The lookup table is generated by the preprocessor: it's shared by all readers and lives in read-only memory.
+// CRC_BIT is one step of the bitwise algorithm, CRC_BYTE(i) is the table entry for byte i.
+#define CRC_BIT(c) (((c) >> 1) ^ (((c)&1) ? CRC_POLYNOMIAL : 0))
+#define CRC_BYTE(i) CRC_BIT(CRC_BIT(CRC_BIT(CRC_BIT(CRC_BIT(CRC_BIT(CRC_BIT(CRC_BIT(i))))))))
+#define CRC_ROW4(i) CRC_BYTE(i), CRC_BYTE(i + 1), CRC_BYTE(i + 2), CRC_BYTE(i + 3)
+#define CRC_ROW16(i) CRC_ROW4(i), CRC_ROW4(i + 4), CRC_ROW4(i + 8), CRC_ROW4(i + 12)
+#define CRC_ROW64(i) CRC_ROW16(i), CRC_ROW16(i + 16), CRC_ROW16(i + 32), CRC_ROW16(i + 48)
+
+static const uint16_t crc_lut[256] = {CRC_ROW64(0), CRC_ROW64(64), CRC_ROW64(128), CRC_ROW64(192)};
 
-void compute_crc(struct crc16_ccitt* s, char* in, int in_len, char out[2])
+void compute_crc(const char* in, int in_len, char out[2])
 {
     uint16_t crc = 0x6363;
     for (int i = 0; i < in_len; ++i)
-        crc = (crc >> 8) ^ s->lut[(uint8_t)(crc ^ in[i])];
+        crc = (crc >> 8) ^ crc_lut[(uint8_t)(crc ^ in[i])];
 
     out[0] = crc & 0xFF;
     out[1] = (crc >> 8) & 0xFF;
@@ -0,0 +1,793 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crc.h"
+#include "emu.h"
+#include "internal.h"
+
+// Default UID: NXP manufacturer code (0x04) followed by arbitrary serial number bytes
+static const char default_nfcid[NTAG_NFCID_LEN] = {0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sleep_until_ns(int64_t t)
+{
+    struct timespec ts = {.tv_sec = t / 1000000000, .tv_nsec = t % 1000000000};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+static void append_crc(char* frame, int len)
+{
+    compute_crc(frame, len, &frame[len]);
+}
+
+static int check_crc(const char* frame, int len)
+{
+    char crc[2];
+    compute_crc(frame, len - 2, crc);
+    return len >= 3 && crc[0] == frame[len - 2] && crc[1] == frame[len - 1];
+}
+
+// NTAG21x section 8.4: the tag returns to IDLE (or HALT, if it was woken up from there) on any unexpected command.
+// A tag in HALT ignores everything but WUPA.
+static void tag_reset_state(struct rc522c_emu_tag* t)
+{
+    if (t->state != RC522C_EMU_TAG_HALT)
+        t->state = t->woken_from_halt ? RC522C_EMU_TAG_HALT : RC522C_EMU_TAG_IDLE;
+}
+
+static int tag_nak(struct rc522c_emu_tag* t, char code, char* out, int* out_last_bits)
+{
+    tag_reset_state(t);
+    out[0] = code;
+    *out_last_bits = NTAG_ACKNAK_RX_BITS;
+    return 1;
+}
+
+// The tag reads its configuration when it's activated, so changes to AUTH0 and ACCESS only apply from the next
+// selection on (ntag_protect relies on this to write PACK and ACCESS after AUTH0 without authenticating)
+static void tag_load_config(struct rc522c_emu_tag* t)
+{
+    int cfg = rc522c_ntag_config_page(t->kind);
+    t->auth0 = t->mem[cfg * 4 + 3];
+    t->prot = (t->mem[(cfg + 1) * 4] & 0x80) != 0;
+}
+
+// Pages at or above AUTH0 require authentication for writing, and for reading if PROT (bit 7 of ACCESS) is set
+static int tag_page_read_protected(struct rc522c_emu_tag* t, int page)
+{
+    return t->prot && page >= t->auth0 && t->state != RC522C_EMU_TAG_AUTHENTICATED;
+}
+
+static int tag_page_write_protected(struct rc522c_emu_tag* t, int page)
+{
+    return page >= t->auth0 && t->state != RC522C_EMU_TAG_AUTHENTICATED;
+}
+
+static void tag_read_page(struct rc522c_emu_tag* t, int page, char* out)
+{
+    // PWD and PACK always read as zeros
+    if (page >= rc522c_ntag_config_page(t->kind) + 2)
+        memset(out, 0, 4);
+    else
+        memcpy(out, &t->mem[page * 4], 4);
+}
+
+// Handles anticollision and selection (cascade levels 1 and 2)
+static int tag_respond_select(struct rc522c_emu_tag* t, const unsigned char* in, int in_bits, char* out)
+{
+    int cl;
+    if (t->state == RC522C_EMU_TAG_READY1 && in[0] == NTAG_CMD_CL1_SEL)
+        cl = 0;
+    else if (t->state == RC522C_EMU_TAG_READY2 && in[0] == NTAG_CMD_CL2_SEL)
+        cl = 1;
+    else
+    {
+        tag_reset_state(t);
+        return -1;
+    }
+
+    // CL1: cascade tag, NFCID_0...2; CL2: NFCID_3...6
+    char uid[5];
+    if (cl == 0)
+    {
+        uid[0] = NFC_CASCADE_TAG;
+        memcpy(&uid[1], &t->mem[0], 3);
+    }
+    else
+    {
+        memcpy(uid, &t->mem[4], 4);
+    }
+    uid[4] = uid[0] ^ uid[1] ^ uid[2] ^ uid[3];
+
+    // NFC Digital Protocol, section 4.7: SDD_REQ carries the UID bits the reader already knows, NVB tells how many.
+    // Tags whose UID doesn't start with them stay silent (and in READY); the others answer with the remaining bits.
+    int known_bits = in_bits - 16;
+    if (known_bits >= 0 && known_bits <= 32 && in[1] == (((2 + known_bits / 8) << 4) | (known_bits % 8)))
+    {
+        for (int i = 0; i < known_bits; ++i)
+            if (((in[2 + i / 8] ^ uid[i / 8]) >> (i % 8)) & 1)
+                return -1;
+        // The first byte is split between the reader and the tag, the reader aligns the reception (RxAlign)
+        int first = known_bits / 8;
+        memcpy(out, &uid[first], 5 - first);
+        out[0] &= (char)(0xFF << (known_bits % 8));
+        return 5 - first;
+    }
+
+    if (in_bits == 9 * 8 && in[1] == NTAG_CMD_SEL_REQ && check_crc((const char*)in, 9))
+    {
+        // SEL_REQ for another tag leaves this one in READY
+        if (memcmp(&in[2], uid, 5) != 0)
+            return -1;
+        // SEL_RES: cascade bit set for CL1 (the UID is not complete yet), cleared for CL2
+        t->state = cl == 0 ? RC522C_EMU_TAG_READY2 : RC522C_EMU_TAG_ACTIVE;
+        if (t->state == RC522C_EMU_TAG_ACTIVE)
+            tag_load_config(t);
+        out[0] = cl == 0 ? 0x04 : 0x00;
+        append_crc(out, 1);
+        return 3;
+    }
+
+    tag_reset_state(t);
+    return -1;
+}
+
+// Handles commands in ACTIVE and AUTHENTICATED states (NTAG21x section 10)
+static int tag_respond_active(struct rc522c_emu* emu, struct rc522c_emu_tag* t, const unsigned char* in, int in_len,
+    char* out, int* out_last_bits, int* delay_us)
+{
+    int pages = rc522c_ntag_page_count(t->kind);
+    int cfg = rc522c_ntag_config_page(t->kind);
+
+    if (!check_crc((const char*)in, in_len))
+        return tag_nak(t, NTAG_NAK_CRC_ERROR, out, out_last_bits);
+
+    switch (in[0])
+    {
+    case NTAG_CMD_READ: {
+        if (in_len != 4 || in[1] >= pages || tag_page_read_protected(t, in[1]))
+            return tag_nak(t, NTAG_NAK_INVALID_ARG, out, out_last_bits);
+        // Reading past the last page rolls over to page 0
+        for (int i = 0; i < 4; ++i)
+        {
+            int page = (in[1] + i) % pages;
+            if (tag_page_read_protected(t, page))
+                memset(&out[i * 4], 0, 4);
+            else
+                tag_read_page(t, page, &out[i * 4]);
+        }
+        append_crc(out, RC522_READ_LEN);
+        return RC522_READ_LEN + 2;
+    }
+    case NTAG_CMD_FAST_READ: {
+        if (in_len != 5 || in[1] > in[2] || in[2] >= pages)
+            return tag_nak(t, NTAG_NAK_INVALID_ARG, out, out_last_bits);
+        for (int page = in[1]; page <= in[2]; ++page)
+        {
+            if (tag_page_read_protected(t, page))
+                return tag_nak(t, NTAG_NAK_INVALID_ARG, out, out_last_bits);
+            tag_read_page(t, page, &out[(page - in[1]) * 4]);
+        }
+        int len = (in[2] - in[1] + 1) * 4;
+        append_crc(out, len);
+        return len + 2;
+    }
+    case NTAG_CMD_WRITE: {
+        // Pages 0 and 1 hold the UID and are read-only
+        if (in_len != 8 || in[1] < 2 || in[1] >= pages || tag_page_write_protected(t, in[1]))
+            return tag_nak(t, NTAG_NAK_INVALID_ARG, out, out_last_bits);
+        char* page = &t->mem[in[1] * 4];
+        if (in[1] == 2)
+        {
+            // Lock bytes can only be set, the rest of page 2 is read-only
+            page[2] |= in[4];
+            page[3] |= in[5];
+        }
+        else if (in[1] == 3)
+        {
+            // Capability container is OTP
+            for (int i = 0; i < 4; ++i)
+                page[i] |= in[2 + i];
+        }
+        else
+        {
+            memcpy(page, &in[2], 4);
+        }
+        *delay_us = emu->write_time_us;
+        out[0] = NTAG_ACK;
+        *out_last_bits = NTAG_ACKNAK_RX_BITS;
+        return 1;
+    }
+    case NTAG_CMD_GET_VERSION: {
+        if (in_len != 3)
+            return tag_nak(t, NTAG_NAK_INVALID_ARG, out, out_last_bits);
+        // NTAG21x section 10.1: fixed header, vendor NXP, NTAG, 50pF, major/minor version, storage size, protocol
+        static const char version[8] = {0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x00, 0x03};
+        memcpy(out, version, 8);
+        switch (t->kind)
+        {
+        case RC522C_TAG_KIND_213:
+            out[NTAG_VERSION_STORAGE_SIZE_BYTE] = NTAG_VERSION_STORAGE_SIZE_213;
+            break;
+        case RC522C_TAG_KIND_215:
+            out[NTAG_VERSION_STORAGE_SIZE_BYTE] = NTAG_VERSION_STORAGE_SIZE_215;
+            break;
+        default:
+            out[NTAG_VERSION_STORAGE_SIZE_BYTE] = NTAG_VERSION_STORAGE_SIZE_216;
+            break;
+        }
+        append_crc(out, 8);
+        return 10;
+    }
+    case NTAG_CMD_PWD_AUTH: {
+        if (in_len != 7 || memcmp(&in[1], &t->mem[(cfg + 2) * 4], RC522_PWD_LEN) != 0)
+            return tag_nak(t, NTAG_NAK_INVALID_ARG, out, out_last_bits);
+        t->state = RC522C_EMU_TAG_AUTHENTICATED;
+        memcpy(out, &t->mem[(cfg + 3) * 4], RC522_PACK_LEN);
+        append_crc(out, RC522_PACK_LEN);
+        return RC522_PACK_LEN + 2;
+    }
+    case NTAG_CMD_HLTA:
+        // NTAG21x section 9.2: no response
+        if (in_len == 4 && in[1] == 0)
+        {
+            t->state = RC522C_EMU_TAG_HALT;
+            return -1;
+        }
+        return tag_nak(t, NTAG_NAK_INVALID_ARG, out, out_last_bits);
+    default:
+        tag_reset_state(t);
+        return -1;
+    }
+}
+
+// Runs a command on the tag. Returns the response length in bytes, or -1 if the tag does not respond.
+static int tag_respond(struct rc522c_emu* emu, struct rc522c_emu_tag* t, const char* in, int in_bits, char* out,
+    int* out_last_bits, int* delay_us)
+{
+    const unsigned char* cmd = (const unsigned char*)in;
+    *out_last_bits = 0;
+    *delay_us = 0;
+
+    if (t->kind == RC522C_TAG_KIND_UNKNOWN)
+        return -1;
+
+    // Short frames (NFC Digital Protocol, section 4.3): REQA is accepted in IDLE, WUPA in IDLE and HALT
+    if (in_bits == 7)
+    {
+        if ((cmd[0] == NTAG_CMD_REQA && t->state == RC522C_EMU_TAG_IDLE) ||
+            (cmd[0] == NTAG_CMD_WUPA && (t->state == RC522C_EMU_TAG_IDLE || t->state == RC522C_EMU_TAG_HALT)))
+        {
+            t->woken_from_halt = t->state == RC522C_EMU_TAG_HALT;
+            t->state = RC522C_EMU_TAG_READY1;
+            // ATQA
+            out[0] = 0x44;
+            out[1] = 0x00;
+            return 2;
+        }
+        tag_reset_state(t);
+        return -1;
+    }
+
+    // SDD_REQ may end with a partial byte
+    if (t->state == RC522C_EMU_TAG_READY1 || t->state == RC522C_EMU_TAG_READY2)
+        return tag_respond_select(t, cmd, in_bits, out);
+
+    if (in_bits % 8 != 0)
+    {
+        tag_reset_state(t);
+        return -1;
+    }
+
+    switch (t->state)
+    {
+    case RC522C_EMU_TAG_ACTIVE:
+    case RC522C_EMU_TAG_AUTHENTICATED:
+        return tag_respond_active(emu, t, cmd, in_bits / 8, out, out_last_bits, delay_us);
+    default:
+        return -1;
+    }
+}
+
+static int field_on(struct rc522c_emu* emu)
+{
+    return (emu->regs[RC522_REG_TX_CTRL] & 0x03) != 0;
+}
+
+// Tags lose power (and their state) when the field is switched off
+static void power_off_tags(struct rc522c_emu* emu)
+{
+    for (int i = 0; i < RC522C_EMU_MAX_TAGS; ++i)
+        emu->tags[i].state = RC522C_EMU_TAG_IDLE;
+}
+
+static int frame_bits(int len, int last_bits)
+{
+    return len * 8 - (last_bits ? 8 - last_bits : 0);
+}
+
+// Superimposes the response of another tag onto emu->response. Bits from the first difference on are lost in the
+// collision; like the chip with ValuesAfterColl = 0 (MFRC522 9.3.1.15), the emulator clears them.
+static void merge_response(struct rc522c_emu* emu, const char* other, int len, int last_bits)
+{
+    int bits = frame_bits(emu->response_len, emu->response_last_bits);
+    int other_bits = frame_bits(len, last_bits);
+    int coll = bits < other_bits ? bits : other_bits;
+    for (int i = 0; i < coll; ++i)
+    {
+        if (((emu->response[i / 8] ^ other[i / 8]) >> (i % 8)) & 1)
+        {
+            coll = i;
+            break;
+        }
+    }
+    if (coll == bits && coll == other_bits)
+        return;
+
+    if (other_bits > bits)
+    {
+        memcpy(&emu->response[emu->response_len], &other[emu->response_len], len - emu->response_len);
+        emu->response_len = len;
+        emu->response_last_bits = last_bits;
+    }
+    if (emu->response_coll < 0 || coll < emu->response_coll)
+        emu->response_coll = coll;
+    for (int i = emu->response_coll; i < emu->response_len * 8; ++i)
+        emu->response[i / 8] &= (char)~(1 << (i % 8));
+}
+
+// Time it takes to receive a byte: 8 data bits + parity
+static int64_t byte_time_ns(struct rc522c_emu* emu)
+{
+    return (int64_t)emu->rf_bit_ns * 9;
+}
+
+// MFRC522 9.3.3.10: delay = (pscl*2+1)*(reload+1) / 13560000Hz
+static int64_t timer_ns(struct rc522c_emu* emu)
+{
+    int64_t prescaler = ((emu->regs[RC522_REG_TIMER_MODE] & 0x0F) << 8) |
+                        (unsigned char)emu->regs[RC522_REG_TIMER_PRESCALER_LO];
+    int64_t reload = ((unsigned char)emu->regs[RC522_REG_TIMER_RELOAD_HI] << 8) |
+                     (unsigned char)emu->regs[RC522_REG_TIMER_RELOAD_LO];
+    return (prescaler * 2 + 1) * (reload + 1) * 1000000 / 13560;
+}
+
+static void start_transceive(struct rc522c_emu* emu)
+{
+    int tx_last_bits = emu->regs[RC522_REG_BIT_FRAMING] & 0x7;
+    int tx_bits = emu->fifo_len * 8 - (tx_last_bits ? 8 - tx_last_bits : 0);
+    char tx[RC522_FIFO_SIZE + 2];
+    memcpy(tx, emu->fifo, emu->fifo_len);
+    // TxCRCEn: the chip appends CRC_A to the frame
+    if (emu->regs[RC522_REG_TX_MODE] & 0x80)
+    {
+        append_crc(tx, emu->fifo_len);
+        tx_bits += 16;
+    }
+    emu->fifo_len = 0;
+    emu->error = 0;
+    emu->rx_last_bits = 0;
+
+    int delay_us = 0;
+    emu->response_len = 0;
+    emu->response_coll = -1;
+    emu->coll = 0x20; // CollPosNotValid
+    for (int i = 0; i < RC522C_EMU_MAX_TAGS && field_on(emu); ++i)
+    {
+        struct rc522c_emu_tag* t = &emu->tags[i];
+        if (t->kind == RC522C_TAG_KIND_UNKNOWN)
+            continue;
+        char out[sizeof(emu->response)];
+        int last_bits, tag_delay_us;
+        int len = tag_respond(emu, t, tx, tx_bits, out, &last_bits, &tag_delay_us);
+        if (len <= 0)
+            continue;
+        if (tag_delay_us > delay_us)
+            delay_us = tag_delay_us;
+        if (emu->response_len == 0)
+        {
+            memcpy(emu->response, out, len);
+            emu->response_len = len;
+            emu->response_last_bits = last_bits;
+        }
+        else
+        {
+            merge_response(emu, out, len, last_bits);
+        }
+    }
+    emu->response_received = 0;
+
+    // RxCRCEn: the chip checks CRC_A and doesn't store it in the FIFO. Frames without one (ACK/NAK) fail the check.
+    emu->response_crc_len = 0;
+    emu->response_crc_error = 0;
+    if ((emu->regs[RC522_REG_RX_MODE] & 0x80) && emu->response_len > 0)
+    {
+        if (emu->response_last_bits == 0 && check_crc(emu->response, emu->response_len))
+            emu->response_crc_len = 2;
+        else
+            emu->response_crc_error = 1;
+    }
+
+    int64_t tx_end = now_ns() + (int64_t)tx_bits * emu->rf_bit_ns;
+    emu->rx_start_ns = tx_end + ((int64_t)emu->fdt_us + delay_us) * 1000;
+    emu->timeout_ns = tx_end + timer_ns(emu);
+    emu->com_irq |= 0x40; // transmission done
+    emu->busy = 1;
+}
+
+// Advances the command in progress up to the current time
+static void update(struct rc522c_emu* emu)
+{
+    int64_t now = now_ns();
+    if (emu->timer_end_ns && now >= emu->timer_end_ns)
+    {
+        emu->com_irq |= 0x01;
+        emu->timer_end_ns = 0;
+    }
+    if (!emu->busy)
+        return;
+
+    // The timer is stopped once the tag starts responding (TAuto)
+    if (now >= emu->timeout_ns && (emu->response_len == 0 || emu->rx_start_ns > emu->timeout_ns))
+        emu->com_irq |= 0x01;
+    if (emu->response_len == 0 || now < emu->rx_start_ns)
+        return;
+
+    int arrived = emu->response_len;
+    if (byte_time_ns(emu) > 0 && (now - emu->rx_start_ns) / byte_time_ns(emu) < arrived)
+        arrived = (now - emu->rx_start_ns) / byte_time_ns(emu);
+
+    int stored = emu->response_len - emu->response_crc_len;
+    int incoming = (arrived < stored ? arrived : stored) - emu->response_received;
+    if (incoming < 0)
+        incoming = 0;
+    int space = RC522_FIFO_SIZE - emu->fifo_len;
+    if (incoming > space)
+    {
+        emu->error |= 0x10; // BufferOvfl, the rest of the data is lost
+        incoming = space;
+    }
+    memcpy(&emu->fifo[emu->fifo_len], &emu->response[emu->response_received], incoming);
+    emu->fifo_len += incoming;
+    emu->response_received = arrived;
+
+    // MFRC522 9.3.1.8: HiAlert = free space in the FIFO <= WaterLevel
+    if (incoming > 0 && RC522_FIFO_SIZE - emu->fifo_len <= emu->regs[RC522_REG_WATER_LEVEL])
+        emu->com_irq |= 0x08;
+
+    if (emu->response_received == emu->response_len)
+    {
+        // MFRC522 9.3.1.15: CollPos counts from 1, 32 is reported as 0
+        if (emu->response_coll >= 0)
+        {
+            emu->error |= 0x08; // CollErr
+            emu->coll = emu->response_coll < 32 ? (emu->response_coll + 1) & 0x1F : 0x20;
+        }
+        if (emu->response_crc_error)
+            emu->error |= 0x04; // CRCErr
+        emu->rx_last_bits = emu->response_last_bits;
+        emu->com_irq |= 0x30; // data received, command terminated
+        emu->busy = 0;
+    }
+}
+
+// Time of the next change in COM_IRQ, or -1 if nothing is going to happen
+static int64_t next_event_ns(struct rc522c_emu* emu)
+{
+    if (!emu->busy)
+        return emu->timer_end_ns ? emu->timer_end_ns : -1;
+    if (emu->response_len == 0 || emu->rx_start_ns > emu->timeout_ns)
+        if (!(emu->com_irq & 0x01))
+            return emu->timeout_ns;
+    if (emu->response_len == 0)
+        return -1;
+    return emu->rx_start_ns + (emu->response_received + 1) * byte_time_ns(emu);
+}
+
+static char read_reg(struct rc522c_emu* emu, int reg)
+{
+    switch (reg)
+    {
+    case RC522_REG_COM_IRQ:
+        update(emu);
+        return emu->com_irq;
+    case RC522_REG_ERROR:
+        update(emu);
+        return emu->error;
+    case RC522_REG_FIFO_LEVEL:
+        update(emu);
+        return emu->fifo_len;
+    case RC522_REG_FIFO_DATA: {
+        update(emu);
+        if (emu->fifo_len == 0)
+            return 0;
+        char val = emu->fifo[0];
+        memmove(emu->fifo, &emu->fifo[1], --emu->fifo_len);
+        return val;
+    }
+    case RC522_REG_CTRL:
+        return emu->rx_last_bits & 0x7;
+    case RC522_REG_COLL:
+        return emu->coll | (emu->regs[RC522_REG_COLL] & 0x80);
+    case RC522_REG_VERSION:
+        return 0x92;
+    default:
+        return emu->regs[reg];
+    }
+}
+
+static void write_reg(struct rc522c_emu* emu, int reg, char val)
+{
+    switch (reg)
+    {
+    case RC522_REG_CMD:
+        emu->regs[reg] = val;
+        if ((val & 0x0F) == RC522_CMD_IDLE)
+            emu->busy = 0;
+        break;
+    case RC522_REG_COM_IRQ:
+        // MFRC522 9.3.1.5: bit 7 selects whether the marked bits are set or cleared
+        if (val & 0x80)
+            emu->com_irq |= val & 0x7F;
+        else
+            emu->com_irq &= ~val;
+        break;
+    case RC522_REG_FIFO_DATA:
+        if (emu->fifo_len < RC522_FIFO_SIZE)
+            emu->fifo[emu->fifo_len++] = val;
+        else
+            emu->error |= 0x10;
+        break;
+    case RC522_REG_FIFO_LEVEL:
+        if (val & 0x80)
+        {
+            emu->fifo_len = 0;
+            emu->error &= ~0x10;
+        }
+        break;
+    case RC522_REG_BIT_FRAMING:
+        emu->regs[reg] = val;
+        if ((val & 0x80) && (emu->regs[RC522_REG_CMD] & 0x0F) == RC522_CMD_TRANSCEIVE)
+            start_transceive(emu);
+        break;
+    case RC522_REG_TX_CTRL:
+        emu->regs[reg] = val;
+        if (!field_on(emu))
+            power_off_tags(emu);
+        break;
+    case RC522_REG_CTRL:
+        // MFRC522 9.3.1.13: TStopNow (bit 7) and TStartNow (bit 6)
+        if (val & 0x80)
+            emu->timer_end_ns = 0;
+        if (val & 0x40)
+            emu->timer_end_ns = now_ns() + timer_ns(emu);
+        break;
+    default:
+        emu->regs[reg & 0x3F] = val;
+        break;
+    }
+}
+
+static void reset_chip(struct rc522c_emu* emu)
+{
+    memset(emu->regs, 0, sizeof(emu->regs));
+    // MFRC522 9.3.3.5: antennas are off after reset
+    emu->regs[RC522_REG_TX_CTRL] = 0x80;
+    emu->fifo_len = 0;
+    emu->error = 0;
+    emu->com_irq = 0x14;
+    emu->coll = 0x20;
+    emu->regs[RC522_REG_COLL] = (char)0x80;
+    emu->rx_last_bits = 0;
+    emu->busy = 0;
+    emu->timer_end_ns = 0;
+    power_off_tags(emu);
+}
+
+static enum rc522c_status emu_xfer(struct rc522c_state* s, const struct rc522c_spi_xfer* xfers, int n)
+{
+    struct rc522c_emu* emu = s->tr.emu.emu;
+    int64_t start = now_ns();
+    int64_t bytes = 0;
+
+    if (emu->in_reset && emu->ready_ns && start >= emu->ready_ns)
+        emu->in_reset = 0;
+
+    for (int i = 0; i < n; ++i)
+    {
+        const struct rc522c_spi_xfer* x = &xfers[i];
+        bytes += x->len;
+        if (x->tx[0] & 0x80)
+        {
+            // MFRC522 8.1.2.1: every byte but the last one is a read address
+            if (x->rx)
+                x->rx[0] = 0;
+            for (int j = 0; j < x->len - 1; ++j)
+            {
+                char val = emu->in_reset ? 0 : read_reg(emu, (x->tx[j] >> 1) & 0x3F);
+                if (emu->max_spi_baud_rate > 0 && emu->spi_baud_rate > emu->max_spi_baud_rate)
+                    val ^= 0x01;
+                if (x->rx)
+                    x->rx[j + 1] = val;
+            }
+        }
+        else if (!emu->in_reset)
+        {
+            // MFRC522 8.1.2.2: all data bytes are written to the same register
+            for (int j = 1; j < x->len; ++j)
+                write_reg(emu, (x->tx[0] >> 1) & 0x3F, x->tx[j]);
+        }
+    }
+
+    // Model the time spent on the bus
+    int64_t cost = emu->xfer_overhead_ns;
+    if (emu->spi_baud_rate > 0)
+        cost += bytes * 8 * 1000000000 / emu->spi_baud_rate;
+    while (now_ns() < start + cost)
+        ;
+
+    return RC522C_STATUS_SUCCESS;
+}
+
+static enum rc522c_status emu_set_rst(struct rc522c_state* s, int level)
+{
+    struct rc522c_emu* emu = s->tr.emu.emu;
+    // The chip keeps ignoring SPI until its oscillator has started
+    emu->in_reset = 1;
+    emu->ready_ns = level ? now_ns() + (int64_t)emu->startup_us * 1000 : 0;
+    if (!level)
+        reset_chip(emu);
+    return RC522C_STATUS_SUCCESS;
+}
+
+// The IRQ line is modeled as level triggered, so there are no stale edges to discard
+static void emu_clear_irq(__attribute__((unused)) struct rc522c_state* s)
+{
+}
+
+static int emu_wait_irq(struct rc522c_state* s, int timeout_us)
+{
+    struct rc522c_emu* emu = s->tr.emu.emu;
+    int64_t deadline = now_ns() + (int64_t)timeout_us * 1000;
+    if (emu->irq_disconnected)
+    {
+        sleep_until_ns(deadline);
+        return 0;
+    }
+    for (;;)
+    {
+        update(emu);
+        if (emu->com_irq & emu->regs[RC522_REG_COM_IEN] & 0x7F)
+            return 1;
+        int64_t next = next_event_ns(emu);
+        if (next < 0 || next > deadline)
+        {
+            sleep_until_ns(deadline);
+            return 0;
+        }
+        sleep_until_ns(next);
+    }
+}
+
+static void emu_close(struct rc522c_state* s)
+{
+    if (s->tr.emu.owned)
+        rc522c_emu_free(s->tr.emu.emu);
+}
+
+static enum rc522c_status emu_set_baud_rate(struct rc522c_state* s, int baud_rate)
+{
+    s->tr.emu.emu->spi_baud_rate = baud_rate;
+    return RC522C_STATUS_SUCCESS;
+}
+
+static const struct rc522c_transport emu_transport = {
+    .xfer = emu_xfer,
+    .set_rst = emu_set_rst,
+    .clear_irq = emu_clear_irq,
+    .wait_irq = emu_wait_irq,
+    .set_baud_rate = emu_set_baud_rate,
+    .close = emu_close,
+};
+
+enum rc522c_status rc522c_transport_emu_open(struct rc522c_state* s, const struct rc522c_config* cfg)
+{
+    s->tr.emu.owned = cfg->emu == NULL;
+    s->tr.emu.emu = cfg->emu;
+    if (s->tr.emu.owned)
+    {
+        s->tr.emu.emu = rc522c_emu_new();
+        if (!s->tr.emu.emu)
+            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_SYSTEM, ENOMEM);
+        s->tr.emu.emu->spi_baud_rate = cfg->spi_baud_rate;
+    }
+    s->transport = &emu_transport;
+    s->irq_pin = cfg->irq_pin;
+    return RC522C_STATUS_SUCCESS;
+}
+
+struct rc522c_emu* rc522c_emu_new(void)
+{
+    struct rc522c_emu* emu = calloc(1, sizeof(struct rc522c_emu));
+    if (!emu)
+        return NULL;
+    // A typical frame delay time (~86us for REQA) and the NTAG21x EEPROM programming time
+    emu->fdt_us = 90;
+    emu->write_time_us = 4100;
+    emu->startup_us = 200;
+    // 106 kbit/s
+    emu->rf_bit_ns = 9440;
+    reset_chip(emu);
+    rc522c_emu_place_tag(emu, RC522C_TAG_KIND_215, default_nfcid);
+    return emu;
+}
+
+void rc522c_emu_free(struct rc522c_emu* emu)
+{
+    free(emu);
+}
+
+static void tag_init(struct rc522c_emu_tag* t, enum rc522c_tag_kind kind, const char* nfcid)
+{
+    memset(t, 0, sizeof(*t));
+    t->kind = kind;
+    t->state = RC522C_EMU_TAG_IDLE;
+    if (!nfcid)
+        nfcid = default_nfcid;
+
+    // NTAG21x section 8.5: UID and check bytes in pages 0...2
+    char* mem = t->mem;
+    memcpy(&mem[0], &nfcid[0], 3);
+    mem[3] = NFC_CASCADE_TAG ^ nfcid[0] ^ nfcid[1] ^ nfcid[2];
+    memcpy(&mem[4], &nfcid[3], 4);
+    mem[8] = nfcid[3] ^ nfcid[4] ^ nfcid[5] ^ nfcid[6];
+    mem[9] = 0x48;
+
+    // Capability container (page 3) with the data area size, followed by an empty NDEF message
+    static const char cc[4] = {(char)0xE1, 0x10, 0x00, 0x00};
+    memcpy(&mem[12], cc, 4);
+    mem[14] = kind == RC522C_TAG_KIND_213 ? 0x12 : kind == RC522C_TAG_KIND_215 ? 0x3E : 0x6D;
+    mem[16] = 0x03;
+    mem[17] = 0x00;
+    mem[18] = (char)0xFE;
+
+    // Configuration pages as delivered; AUTH0 = 0xFF disables password protection
+    int cfg = rc522c_ntag_config_page(kind);
+    static const char cfg_pages[16] = {
+        0x04, 0x00, 0x00, (char)0xFF, 0x00, 0x05, 0x00, 0x00, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF};
+    memcpy(&mem[cfg * 4], cfg_pages, sizeof(cfg_pages));
+}
+
+void rc522c_emu_place_tag(struct rc522c_emu* emu, enum rc522c_tag_kind kind, const char* nfcid)
+{
+    memset(emu->tags, 0, sizeof(emu->tags));
+    if (kind != RC522C_TAG_KIND_UNKNOWN)
+        tag_init(&emu->tags[0], kind, nfcid);
+}
+
+int rc522c_emu_add_tag(struct rc522c_emu* emu, enum rc522c_tag_kind kind, const char* nfcid)
+{
+    for (int i = 0; i < RC522C_EMU_MAX_TAGS; ++i)
+    {
+        if (emu->tags[i].kind == RC522C_TAG_KIND_UNKNOWN)
+        {
+            tag_init(&emu->tags[i], kind, nfcid);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void rc522c_emu_remove_tag(struct rc522c_emu* emu)
+{
+    rc522c_emu_place_tag(emu, RC522C_TAG_KIND_UNKNOWN, NULL);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "rc522c.h"
+
+// Software model of an MFRC522 with NTAG21x tags in its field, used as the RC522C_TRANSPORT_EMULATOR backend.
+// It answers the register accesses issued by rc522c.c (FIFO, COM_IRQ, ERROR, CTRL, timer) and runs the
+// NTAG21x command set on the tag side, so the rc522c_* API can be exercised and benchmarked without hardware.
+
+// NTAG21x section 8.4: tag states
+enum rc522c_emu_tag_state
+{
+  RC522C_EMU_TAG_IDLE,
+  RC522C_EMU_TAG_READY1,
+  RC522C_EMU_TAG_READY2,
+  RC522C_EMU_TAG_ACTIVE,
+  RC522C_EMU_TAG_AUTHENTICATED,
+  RC522C_EMU_TAG_HALT
+};
+
+struct rc522c_emu_tag
+{
+    // RC522C_TAG_KIND_UNKNOWN if the slot is empty
+    enum rc522c_tag_kind kind;
+    char mem[NTAG_MAX_PAGES * 4];
+    enum rc522c_emu_tag_state state;
+    // Whether the tag was woken up from HALT; it returns to HALT rather than IDLE on errors
+    int woken_from_halt;
+    // AUTH0 and PROT as of the last activation
+    unsigned char auth0;
+    int prot;
+};
+
+// Maximum number of tags in the field at once
+#define RC522C_EMU_MAX_TAGS 8
+
+struct rc522c_emu
+{
+    // Timing model. Frame delay time: from the end of transmission until the tag starts responding
+    int fdt_us;
+    // Extra time the tag takes to answer WRITE (EEPROM programming)
+    int write_time_us;
+    // Duration of a single bit on air; 106 kbit/s by default
+    int rf_bit_ns;
+    // SPI clock used to model the time spent in transport calls, 0 to make them free.
+    int spi_baud_rate;
+    // Above this clock, register reads return corrupted data, like with long or noisy wiring. 0 for no limit.
+    int max_spi_baud_rate;
+    // Fixed cost of every transport call (e.g. a system call or the pigpio overhead)
+    int xfer_overhead_ns;
+    // Time from releasing RST until the chip answers on SPI (oscillator start-up)
+    int startup_us;
+    // Set to model an IRQ line that doesn't reach the GPIO the driver waits on (not wired, or wired to another pin):
+    // interrupts are still flagged in COM_IRQ, but never arrive
+    int irq_disconnected;
+
+    // Tags in the field. All of them receive every frame; when several answer at once, their responses are
+    // superimposed and the first differing bit is reported as a collision (CollReg), see start_transceive
+    struct rc522c_emu_tag tags[RC522C_EMU_MAX_TAGS];
+
+    // Set while RST is held low, and until startup_us after it's released: the chip ignores writes and reads back
+    // zeros
+    int in_reset;
+    int64_t ready_ns;
+    // MFRC522 register file; registers with side effects are modeled separately
+    char regs[64];
+    char fifo[RC522_FIFO_SIZE];
+    int fifo_len;
+    char error;
+    char com_irq;
+    // CollReg: position of the first collision in the received frame
+    char coll;
+    // Valid bits in the last received byte (CTRL register)
+    int rx_last_bits;
+
+    // Command in progress: the tag response is received at rx_start_ns + byte_index * byte time.
+    // Bytes that don't fit into the FIFO yet stay in response until the host drains it.
+    int busy;
+    int64_t rx_start_ns;
+    int64_t timeout_ns;
+    char response[NTAG_MAX_PAGES * 4 + 2];
+    int response_len;
+    int response_last_bits;
+    int response_received;
+    // Trailing CRC_A bytes that are checked by the chip (RxCRCEn) rather than stored in the FIFO
+    int response_crc_len;
+    int response_crc_error;
+    // Bit index of the first collision in response, -1 if only one tag answered (or they all sent the same bits)
+    int response_coll;
+    // Timer started by hand (ControlReg TStartNow) rather than by a transmission: TimerIRq is raised at this time.
+    // 0 if it isn't running.
+    int64_t timer_end_ns;
+};
+
+// Creates an emulator with default timing and an NTAG215 in the field
+struct rc522c_emu* rc522c_emu_new(void);
+void rc522c_emu_free(struct rc522c_emu* emu);
+
+// Places a factory-fresh tag into the field, replacing the current ones. nfcid is NTAG_NFCID_LEN bytes long.
+void rc522c_emu_place_tag(struct rc522c_emu* emu, enum rc522c_tag_kind kind, const char* nfcid);
+// Places one more tag into the field (e.g. a stack of tickets). Returns -1 if the field is full.
+int rc522c_emu_add_tag(struct rc522c_emu* emu, enum rc522c_tag_kind kind, const char* nfcid);
+// Removes all tags from the field
+void rc522c_emu_remove_tag(struct rc522c_emu* emu);
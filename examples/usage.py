@@ -20,10 +20,11 @@ PASSWORD = b"\xAB\x06\x05\xFF"
 PACK = b"\xB0\xBA"
 
 try:
-    rc522 = RC522(spi_baud_rate=1_000_000, antenna_gain=4, rst_pin=25)
+    # irq_pin matches the IRQ wiring above. Leave it out if IRQ isn't connected: the chip is then polled over SPI.
+    rc522 = RC522(spi_baud_rate=1_000_000, antenna_gain=4, rst_pin=25, irq_pin=24)
     print(f"Device version: {hex(rc522.dev_version)}")
-    while not rc522.ntag_try_select():
-        pass
+    # Probes for a tag every 50ms, keeping the antenna off in between
+    rc522.wait_for_tag(interval=0.05)
     print(f"Detected {rc522.tag_kind} with NFCID {rc522.tag_nfcid}")
 
     # Section 8.8.1 of the NTAG21x datasheet recommends to "diversify the password and the password acknowledge"
@@ -38,7 +39,8 @@ try:
     except RC522TagError as e:
         # NTAG21x datasheet, section 8.4: "the command interpreter returns to the idle state on receipt of an unexpected command"
         # So if the authentication fails, the tag returns to the idle state and needs to be selected again.
-        while not rc522.ntag_try_select():
+        # We already know its NFCID, so reselecting is quicker than going through the full anticollision again.
+        while not rc522.ntag_try_reselect():
             pass
         # Let's assume that the tag is not protected yet (the configuration pages are available for writing).
         # It's recommended to always password-protect at least the configuration pages
@@ -60,8 +62,9 @@ try:
 except RC522Error as e:
     # Error hierarchy: RC522Error <- RC522TagError
     # This is a catch-all for tag errors (recoverable) as well as device/IO errors (may be unrecoverable).
-    # A possible recovery strategy is to try to create a new instance of RC522 and repeat your actions.
-    # The instance constructor performs a hard reset of the device, which may help.
+    # A possible recovery strategy is to call rc522.recover() and repeat your actions: it hard resets the device
+    # and restores its configuration in a couple of milliseconds, keeping SPI and GPIO open.
+    # If that fails too, try to create a new instance of RC522, which sets up SPI and GPIO from scratch.
     #
     # Note that some errors could require a full reboot of RPi. For instance, you might see
     # a pigpio error "init mbox zaps failed". This means there's not enough free GPU (DMA) memory.
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "rc522c.h"
+
+// Error handling helpers shared by rc522c.c and the transport backends
+
+// clang-format off
+#define SET_RC522C_ERROR(s, _error_code) {s->error_file = __FILE__; s->error_line = __LINE__; s->error_code = _error_code;}
+#define CHECK_PIGPIO(s, expr) {int ret = expr; if (ret < 0) { SET_RC522C_ERROR(s, ret); return RC522C_STATUS_ERROR_PIGPIO; }}
+#define CHECK_SYSCALL(s, expr) {if ((expr) < 0) { SET_RC522C_ERROR(s, errno); return RC522C_STATUS_ERROR_SYSTEM; }}
+#define CHECK_RC522C_STATUS(s, expr) {enum rc522c_status ret = expr; if (ret != RC522C_STATUS_SUCCESS) { return ret; }}
+#define RETURN_RC522C_ERROR(s, status, _error_code) {SET_RC522C_ERROR(s, _error_code); return status;}
+// clang-format on
+
+// Transport backends. On success, s->transport is set; on failure, it's left NULL unless
+// there's something for rc522c_deinit to clean up.
+enum rc522c_status rc522c_transport_pigpio_open(struct rc522c_state* s, const struct rc522c_config* cfg);
+enum rc522c_status rc522c_transport_spidev_open(struct rc522c_state* s, const struct rc522c_config* cfg);
+enum rc522c_status rc522c_transport_emu_open(struct rc522c_state* s, const struct rc522c_config* cfg);
+
+void rc522c_sleep_us(int us);
+
+// Errors caused by the tag (or its absence) rather than the reader: the tag is missing, unsupported, collided with
+// another one or NAKed the command
+int rc522c_is_tag_error(enum rc522c_status status);
+
+// Configuration pages (CFG0, CFG1, PWD, PACK) are the last four pages of the memory
+int rc522c_ntag_config_page(enum rc522c_tag_kind kind);
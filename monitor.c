@@ -0,0 +1,216 @@
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "internal.h"
+#include "monitor.h"
+
+int rc522c_event_ring_push(struct rc522c_event_ring* r, const struct rc522c_event* ev)
+{
+    unsigned int head = r->head;
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == RC522C_EVENT_RING_SIZE)
+    {
+        __atomic_fetch_add(&r->dropped, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    r->events[head & (RC522C_EVENT_RING_SIZE - 1)] = *ev;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+int rc522c_event_ring_pop(struct rc522c_event_ring* r, struct rc522c_event* out)
+{
+    unsigned int tail = r->tail;
+    if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail)
+        return 0;
+    *out = r->events[tail & (RC522C_EVENT_RING_SIZE - 1)];
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static long long monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void publish(struct rc522c_monitor* m, const struct rc522c_event* ev)
+{
+    rc522c_event_ring_push(&m->ring, ev);
+    if (m->cfg.notify)
+        m->cfg.notify(m->cfg.ctx);
+}
+
+// Checks that the tracked tag is still there. A tag that's dropped out of the selected state (e.g. after a NAK, or
+// because the application selected another one) is brought back the cheapest way available.
+static enum rc522c_status poll_tag(struct rc522c_state* s, const char* nfcid)
+{
+    if (s->tag_selected && memcmp(s->tag_nfcid, nfcid, NTAG_NFCID_LEN) == 0)
+    {
+        enum rc522c_status status = rc522c_ntag_present(s);
+        if (!rc522c_is_tag_error(status))
+            return status;
+    }
+    if (s->tag_known && memcmp(s->tag_nfcid, nfcid, NTAG_NFCID_LEN) == 0)
+        return rc522c_ntag_reselect(s);
+    return rc522c_ntag_select_nfcid(s, nfcid);
+}
+
+static void* monitor_thread(void* arg)
+{
+    struct rc522c_monitor* m = arg;
+    struct rc522c_state* s = m->s;
+    const struct rc522c_monitor_config* cfg = &m->cfg;
+    int duty_cycle = cfg->interval_us > RC522C_FIELD_GUARD_US;
+
+    // The tracked tag is a candidate until it has been seen on arrive_polls consecutive polls, and is reported
+    // from then on
+    struct rc522c_event tag = {0};
+    int tracking = 0, reported = 0, hits = 0, misses = 0;
+    long long first_miss_ns = 0;
+
+    long long next_ns = monotonic_ns();
+    for (;;)
+    {
+        long long poll_ns = monotonic_ns();
+        enum rc522c_status status;
+        if (cfg->lock)
+            cfg->lock(cfg->ctx);
+        if (!tracking)
+        {
+            status = rc522c_ntag_wait_for_tag(s, 0, cfg->interval_us);
+            if (status == RC522C_STATUS_SUCCESS)
+            {
+                tracking = 1;
+                hits = misses = reported = 0;
+                memcpy(tag.nfcid, s->tag_nfcid, NTAG_NFCID_LEN);
+                tag.tag_kind = s->tag_kind;
+                tag.timestamp_ns = poll_ns;
+            }
+            else if (status == RC522C_STATUS_ERROR_TAG_MISSING && duty_cycle)
+            {
+                status = rc522c_set_antenna(s, 0);
+                if (status == RC522C_STATUS_SUCCESS)
+                    status = RC522C_STATUS_ERROR_TAG_MISSING;
+            }
+        }
+        else
+        {
+            status = poll_tag(s, tag.nfcid);
+        }
+
+        if (status != RC522C_STATUS_SUCCESS && !rc522c_is_tag_error(status))
+        {
+            struct rc522c_event ev = {.kind = RC522C_EVENT_ERROR,
+                .timestamp_ns = poll_ns,
+                .status = status,
+                .error_code = s->error_code,
+                .error_file = s->error_file,
+                .error_line = s->error_line};
+            if (cfg->unlock)
+                cfg->unlock(cfg->ctx);
+            publish(m, &ev);
+            return NULL;
+        }
+        if (cfg->unlock)
+            cfg->unlock(cfg->ctx);
+
+        if (status == RC522C_STATUS_SUCCESS)
+        {
+            hits++;
+            misses = 0;
+            if (!reported && hits >= cfg->arrive_polls)
+            {
+                tag.kind = RC522C_EVENT_ARRIVED;
+                publish(m, &tag);
+                reported = 1;
+            }
+        }
+        else if (tracking && !reported)
+        {
+            // Candidates have to be seen on consecutive polls
+            tracking = 0;
+        }
+        else if (tracking)
+        {
+            if (misses++ == 0)
+                first_miss_ns = poll_ns;
+            if (misses >= cfg->remove_polls)
+            {
+                struct rc522c_event ev = tag;
+                ev.kind = RC522C_EVENT_REMOVED;
+                ev.timestamp_ns = first_miss_ns;
+                publish(m, &ev);
+                tracking = 0;
+            }
+        }
+
+        // Polls are kept on a fixed schedule, unless they fall behind it
+        next_ns += cfg->interval_us * 1000LL;
+        if (next_ns < monotonic_ns())
+            next_ns = monotonic_ns();
+        struct timespec deadline = {.tv_sec = next_ns / 1000000000LL, .tv_nsec = next_ns % 1000000000LL};
+        pthread_mutex_lock(&m->mutex);
+        while (!m->stop && pthread_cond_timedwait(&m->cond, &m->mutex, &deadline) != ETIMEDOUT)
+            ;
+        int stop = m->stop;
+        pthread_mutex_unlock(&m->mutex);
+        if (stop)
+            break;
+    }
+
+    // Leave the field on, as rc522c_init does
+    if (duty_cycle)
+    {
+        if (cfg->lock)
+            cfg->lock(cfg->ctx);
+        rc522c_set_antenna(s, 1);
+        if (cfg->unlock)
+            cfg->unlock(cfg->ctx);
+    }
+    return NULL;
+}
+
+enum rc522c_status rc522c_monitor_start(
+    struct rc522c_monitor* m, struct rc522c_state* s, const struct rc522c_monitor_config* cfg)
+{
+    if (cfg->interval_us < 0 || cfg->arrive_polls < 1 || cfg->remove_polls < 1)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_SYSTEM, EINVAL);
+
+    memset(m, 0, sizeof(struct rc522c_monitor));
+    m->s = s;
+    m->cfg = *cfg;
+
+    // The wait between polls is measured on CLOCK_MONOTONIC, like the event timestamps
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&m->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&m->mutex, NULL);
+
+    int err = pthread_create(&m->thread, NULL, monitor_thread, m);
+    if (err != 0)
+    {
+        pthread_cond_destroy(&m->cond);
+        pthread_mutex_destroy(&m->mutex);
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_SYSTEM, err);
+    }
+    m->started = 1;
+    return RC522C_STATUS_SUCCESS;
+}
+
+void rc522c_monitor_stop(struct rc522c_monitor* m)
+{
+    if (!m->started)
+        return;
+    pthread_mutex_lock(&m->mutex);
+    m->stop = 1;
+    pthread_cond_signal(&m->cond);
+    pthread_mutex_unlock(&m->mutex);
+    pthread_join(m->thread, NULL);
+    pthread_cond_destroy(&m->cond);
+    pthread_mutex_destroy(&m->mutex);
+    m->started = 0;
+}
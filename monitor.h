@@ -0,0 +1,100 @@
+#pragma once
+
+#include <pthread.h>
+
+#include "rc522c.h"
+
+// Background tag presence monitor. A thread polls the reader, debounces tag presence and publishes arrival and removal
+// events into a single-producer/single-consumer ring, which the application drains at its own pace without taking
+// locks. A tag has to be seen on arrive_polls consecutive polls before it's reported, and missed on remove_polls
+// consecutive polls before it's reported gone, so a tag sitting on the edge of the field doesn't produce a stream of
+// events.
+
+enum rc522c_event_kind
+{
+  RC522C_EVENT_ARRIVED,
+  RC522C_EVENT_REMOVED,
+  // The reader failed with a device error (see status); the monitor thread has stopped
+  RC522C_EVENT_ERROR
+};
+
+struct rc522c_event
+{
+    enum rc522c_event_kind kind;
+    // CLOCK_MONOTONIC time of the poll that first saw the change, in nanoseconds. Debouncing delays the event,
+    // not its timestamp.
+    long long timestamp_ns;
+    // The tag that arrived or left
+    char nfcid[NTAG_NFCID_LEN];
+    enum rc522c_tag_kind tag_kind;
+    // RC522C_EVENT_ERROR: the error and its details, as found in rc522c_state
+    enum rc522c_status status;
+    int error_code;
+    const char* error_file;
+    int error_line;
+};
+
+// Must be a power of two
+#define RC522C_EVENT_RING_SIZE 64
+
+// head is only written by the producer and tail only by the consumer; each side reads the other's index with acquire
+// semantics, which makes the event contents it guards visible. The indices run freely and wrap around.
+struct rc522c_event_ring
+{
+    struct rc522c_event events[RC522C_EVENT_RING_SIZE];
+    // Kept on separate cache lines so that the two sides don't keep stealing each other's line
+    unsigned int head __attribute__((aligned(64)));
+    unsigned int tail __attribute__((aligned(64)));
+    // Events the producer had to discard because the ring was full
+    unsigned int dropped;
+};
+
+// Producer side. Returns 0 and counts a dropped event if the ring is full.
+int rc522c_event_ring_push(struct rc522c_event_ring* r, const struct rc522c_event* ev);
+// Consumer side. Returns 0 if the ring is empty.
+int rc522c_event_ring_pop(struct rc522c_event_ring* r, struct rc522c_event* out);
+
+#define RC522C_MONITOR_DEFAULT_INTERVAL_US 50000
+#define RC522C_MONITOR_DEFAULT_ARRIVE_POLLS 2
+#define RC522C_MONITOR_DEFAULT_REMOVE_POLLS 3
+
+struct rc522c_monitor_config
+{
+    // Time between polls. While no tag is present, the field is probed as in rc522c_ntag_wait_for_tag (switched
+    // off between probes if interval_us is longer than RC522C_FIELD_GUARD_US); a present tag is checked with
+    // rc522c_ntag_present, falling back to a reselect.
+    int interval_us;
+    int arrive_polls;
+    int remove_polls;
+    // Called around every poll to serialize access to the reader with other threads. May be NULL if nothing else
+    // uses the reader while the monitor runs.
+    void (*lock)(void* ctx);
+    void (*unlock)(void* ctx);
+    // Called on the monitor thread after an event has been pushed, e.g. to wake up the consumer. May be NULL.
+    void (*notify)(void* ctx);
+    void* ctx;
+};
+
+struct rc522c_monitor
+{
+    struct rc522c_state* s;
+    struct rc522c_monitor_config cfg;
+    struct rc522c_event_ring ring;
+
+    pthread_t thread;
+    int started;
+    // Protects stop, which cuts the wait between polls short
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int stop;
+};
+
+// Starts the monitor thread on s. While it runs, the monitor owns tag detection: the application should leave
+// selecting to it and only talk to the tag reported by the last RC522C_EVENT_ARRIVED (from other threads, the
+// lock callbacks have to serialize access to s). Fails with RC522C_STATUS_ERROR_SYSTEM if the thread can't be created.
+enum rc522c_status rc522c_monitor_start(
+    struct rc522c_monitor* m, struct rc522c_state* s, const struct rc522c_monitor_config* cfg);
+
+// Stops the monitor thread and waits for it to exit. The field is left on. Events still in the ring can be drained
+// afterwards.
+void rc522c_monitor_stop(struct rc522c_monitor* m);
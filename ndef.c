@@ -0,0 +1,151 @@
+#include <string.h>
+
+#include "internal.h"
+#include "ndef.h"
+
+int rc522c_ndef_area_size(enum rc522c_tag_kind kind)
+{
+    switch (kind)
+    {
+    case RC522C_TAG_KIND_213:
+        return 0x12 * 8;
+    case RC522C_TAG_KIND_215:
+        return 0x3E * 8;
+    case RC522C_TAG_KIND_216:
+        return 0x6D * 8;
+    default:
+        return 0;
+    }
+}
+
+struct ndef_reader
+{
+    struct rc522c_state* s;
+    // Tag memory by byte address. Bytes below fetched_end have been read.
+    char mem[NTAG_MAX_PAGES * 4];
+    int fetched_end;
+    // End of the data area (byte address)
+    int area_end;
+};
+
+// Makes sure that the bytes below end have been read. The missing pages are fetched with a single FAST_READ, which
+// covers at least min_pages pages, so that walking over short TLVs doesn't cost a command each, but never goes past
+// the data area.
+static enum rc522c_status ndef_fetch(struct ndef_reader* r, int end, int min_pages)
+{
+    if (end <= r->fetched_end)
+        return RC522C_STATUS_SUCCESS;
+    if (end > r->area_end)
+        RETURN_RC522C_ERROR(r->s, RC522C_STATUS_ERROR_NDEF_INVALID, end);
+
+    int first_page = r->fetched_end / 4;
+    int last_page = (end + 3) / 4 - 1;
+    if (last_page < first_page + min_pages - 1)
+        last_page = first_page + min_pages - 1;
+    if (last_page > r->area_end / 4 - 1)
+        last_page = r->area_end / 4 - 1;
+
+    CHECK_RC522C_STATUS(r->s, rc522c_ntag_read_range(r->s, first_page, last_page, &r->mem[first_page * 4]));
+    r->fetched_end = (last_page + 1) * 4;
+    return RC522C_STATUS_SUCCESS;
+}
+
+enum rc522c_status rc522c_ndef_read(struct rc522c_state* s, char* out, int* out_len)
+{
+    if (!s->tag_selected)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, 0);
+    int area_size = rc522c_ndef_area_size(s->tag_kind);
+    if (area_size == 0)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+
+    struct ndef_reader r;
+    r.s = s;
+
+    // A READ returns four pages: the CC and the first 12 bytes of the data area, which is where a short message
+    // (or at least its TLV header) lives
+    CHECK_RC522C_STATUS(s, rc522c_ntag_read(s, NDEF_CC_PAGE, &r.mem[NDEF_CC_PAGE * 4]));
+    r.fetched_end = NDEF_CC_PAGE * 4 + RC522_READ_LEN;
+
+    const unsigned char* cc = (const unsigned char*)&r.mem[NDEF_CC_PAGE * 4];
+    if (cc[0] != NDEF_CC_MAGIC)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_NDEF_INVALID, NDEF_CC_PAGE * 4);
+    if (cc[2] * 8 < area_size)
+        area_size = cc[2] * 8;
+    r.area_end = NDEF_DATA_START_PAGE * 4 + area_size;
+
+    const unsigned char* mem = (const unsigned char*)r.mem;
+    int pos = NDEF_DATA_START_PAGE * 4;
+    while (pos < r.area_end)
+    {
+        CHECK_RC522C_STATUS(s, ndef_fetch(&r, pos + 1, 4));
+        int type = mem[pos];
+        if (type == NDEF_TLV_NULL)
+        {
+            ++pos;
+            continue;
+        }
+        if (type == NDEF_TLV_TERMINATOR)
+            break;
+
+        CHECK_RC522C_STATUS(s, ndef_fetch(&r, pos + 2, 4));
+        int len = mem[pos + 1];
+        int header = 2;
+        if (len == NDEF_TLV_LONG_LENGTH)
+        {
+            CHECK_RC522C_STATUS(s, ndef_fetch(&r, pos + 4, 4));
+            len = (mem[pos + 2] << 8) | mem[pos + 3];
+            header = 4;
+        }
+
+        if (type == NDEF_TLV_MESSAGE)
+        {
+            // A message that runs to the very end of NTAG216's data area, leaving no room for a Terminator TLV, is
+            // still within the area but longer than out has to be
+            if (len > RC522C_NDEF_MAX_LEN)
+                RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_NDEF_INVALID, pos);
+            // The length is known now: fetch exactly the pages that hold the rest of the message
+            CHECK_RC522C_STATUS(s, ndef_fetch(&r, pos + header + len, 1));
+            memcpy(out, &r.mem[pos + header], len);
+            *out_len = len;
+            return RC522C_STATUS_SUCCESS;
+        }
+        // Lock Control, Memory Control and proprietary TLVs are skipped
+        pos += header + len;
+    }
+
+    RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_NDEF_INVALID, pos);
+}
+
+enum rc522c_status rc522c_ndef_write(struct rc522c_state* s, const char* msg, int len, int* out_pages_written)
+{
+    if (out_pages_written)
+        *out_pages_written = 0;
+    if (!s->tag_selected)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, 0);
+    int area_size = rc522c_ndef_area_size(s->tag_kind);
+    if (area_size == 0)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+
+    int header = len < NDEF_TLV_LONG_LENGTH ? 2 : 4;
+    if (len < 0 || header + len + 1 > area_size)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_OUT_OF_RANGE, 0);
+
+    char tlv[NTAG_MAX_PAGES * 4];
+    int n = 0;
+    tlv[n++] = NDEF_TLV_MESSAGE;
+    if (header == 2)
+    {
+        tlv[n++] = len;
+    }
+    else
+    {
+        tlv[n++] = (char)NDEF_TLV_LONG_LENGTH;
+        tlv[n++] = len >> 8;
+        tlv[n++] = len & 0xFF;
+    }
+    memcpy(&tlv[n], msg, len);
+    n += len;
+    tlv[n++] = (char)NDEF_TLV_TERMINATOR;
+
+    return rc522c_ntag_write_bytes(s, NDEF_DATA_START_PAGE * 4, tlv, n, out_pages_written);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "rc522c.h"
+
+// NDEF storage on NTAG21x, as laid out by the NFC Forum Type 2 Tag specification: the capability container (CC) in
+// page 3 describes the data area, which starts at page 4 and holds a sequence of TLV blocks. An NDEF message is
+// stored in an NDEF Message TLV, usually followed by a Terminator TLV.
+
+// NFC Forum Type 2 Tag, section 2.3 / NTAG21x section 8.5.6
+#define NDEF_CC_PAGE 3
+#define NDEF_CC_MAGIC 0xE1
+#define NDEF_DATA_START_PAGE 4
+
+// NFC Forum Type 2 Tag, section 2.3: TLV types. NULL and Terminator TLVs have no length field.
+#define NDEF_TLV_NULL 0x00
+#define NDEF_TLV_MESSAGE 0x03
+#define NDEF_TLV_TERMINATOR 0xFE
+// Lengths of 0xFF and above take three bytes: 0xFF followed by the length, big endian
+#define NDEF_TLV_LONG_LENGTH 0xFF
+
+// Size of the data area in bytes as given by the factory-programmed CC (NTAG21x section 8.5.6), 0 for unknown tags
+int rc522c_ndef_area_size(enum rc522c_tag_kind kind);
+
+// The largest message that fits into the data area of NTAG216 along with a long TLV header and a terminator
+#define RC522C_NDEF_MAX_LEN (872 - 4 - 1)
+
+// Reads the NDEF message from the selected tag into out, which _must_ be able to fit RC522C_NDEF_MAX_LEN bytes;
+// out_len receives its length. Pages are fetched only as the TLV walk reaches them: one READ for the CC and the
+// start of the data area, then FAST_READs of just the pages that hold the rest of the message. Fails with
+// RC522C_STATUS_ERROR_NDEF_INVALID if the tag is not NDEF formatted, holds no (complete) NDEF Message TLV, or holds
+// one longer than RC522C_NDEF_MAX_LEN.
+enum rc522c_status rc522c_ndef_read(struct rc522c_state* s, char* out, int* out_len);
+
+// Stores an NDEF message of len bytes on the selected tag, as an NDEF Message TLV followed by a Terminator TLV at the
+// start of the data area. Only the pages whose contents change are written (see rc522c_ntag_write_bytes), so
+// rewriting a message with a small change costs a read and a write or two. Fails with
+// RC522C_STATUS_ERROR_OUT_OF_RANGE if the message doesn't fit the data area of the tag. If out_pages_written is not
+// NULL, it receives the number of WRITE commands issued.
+enum rc522c_status rc522c_ndef_write(struct rc522c_state* s, const char* msg, int len, int* out_pages_written);
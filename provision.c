@@ -0,0 +1,125 @@
+#include <string.h>
+#include <time.h>
+
+#include "internal.h"
+#include "provision.h"
+
+// NTAG21x section 8.5.7: CFG0 = MIRROR, RFUI, MIRROR_PAGE, AUTH0; CFG1 = ACCESS, RFUI, RFUI, RFUI
+#define CFG0_FACTORY_MIRROR 0x04
+#define CFG1_ACCESS_PROT 0x80
+
+enum rc522c_status rc522c_provision_prepare(
+    struct rc522c_state* s, const struct rc522c_provision_image* image, struct rc522c_provision* p)
+{
+    int config_page = rc522c_ntag_config_page(image->tag_kind);
+    if (config_page < 0)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+    if (image->len < 0 || image->len % 4 != 0)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_OUT_OF_RANGE, 0);
+    // User memory starts at page 4 and ends right before the dynamic lock bytes, which precede the configuration pages
+    int end_page = image->start_page + image->len / 4 - 1;
+    if (image->len > 0 && (image->start_page < 4 || end_page >= config_page - 1))
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_OUT_OF_RANGE, 0);
+    if (image->protect && (image->auth0 < 0 || image->auth0 > 0xFF))
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_OUT_OF_RANGE, 0);
+
+    memset(p, 0, sizeof(struct rc522c_provision));
+    p->image = *image;
+    p->image.data = NULL;
+    p->config_page = config_page;
+    p->data_frame_count = image->len / 4;
+    for (int i = 0; i < p->data_frame_count; i++)
+        rc522c_ntag_build_write_frame(p->data_frames[i], image->start_page + i, &image->data[i * 4]);
+
+    char cfg1[RC522_WRITE_LEN] = {(char)(image->rw ? CFG1_ACCESS_PROT : 0), 0, 0, 0};
+    char cfg0[RC522_WRITE_LEN] = {CFG0_FACTORY_MIRROR, 0, 0, (char)image->auth0};
+    rc522c_ntag_build_write_frame(p->config_frames[0], config_page + 1, cfg1);
+    rc522c_ntag_build_write_frame(p->config_frames[1], config_page, cfg0);
+    return RC522C_STATUS_SUCCESS;
+}
+
+static enum rc522c_status write_frame(
+    struct rc522c_state* s, const char* frame, struct rc522c_provision_report* report)
+{
+    enum rc522c_status status = rc522c_ntag_write_frame(s, frame);
+    if (status != RC522C_STATUS_SUCCESS)
+    {
+        report->failed_page = (unsigned char)frame[1];
+        return status;
+    }
+    report->pages_written++;
+    return RC522C_STATUS_SUCCESS;
+}
+
+static enum rc522c_status provision(
+    struct rc522c_state* s, const struct rc522c_provision* p, struct rc522c_provision_report* report)
+{
+    const struct rc522c_provision_image* image = &p->image;
+    if (s->tag_kind != image->tag_kind)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, s->tag_kind);
+
+    for (int i = 0; i < p->data_frame_count; i++)
+        CHECK_RC522C_STATUS(s, write_frame(s, p->data_frames[i], report));
+
+    if (image->verify && p->data_frame_count > 0)
+    {
+        char readback[NTAG_MAX_PAGES * 4];
+        int end_page = image->start_page + p->data_frame_count - 1;
+        CHECK_RC522C_STATUS(s, rc522c_ntag_read_range(s, image->start_page, end_page, readback));
+        for (int i = 0; i < p->data_frame_count; i++)
+            if (memcmp(&readback[i * 4], &p->data_frames[i][2], RC522_WRITE_LEN) != 0)
+                RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_VERIFY_FAILED, image->start_page + i);
+    }
+
+    if (!image->protect)
+        return RC522C_STATUS_SUCCESS;
+
+    // PWD and PACK are the only frames that differ from tag to tag
+    memcpy(report->pwd, image->pwd, RC522_PWD_LEN);
+    memcpy(report->pack, image->pack, RC522_PACK_LEN);
+    if (image->diversify)
+    {
+        for (int i = 0; i < RC522_PWD_LEN; i++)
+            report->pwd[i] ^= s->tag_nfcid[i];
+        for (int i = 0; i < RC522_PACK_LEN; i++)
+            report->pack[i] ^= s->tag_nfcid[i];
+    }
+    char frame[RC522C_WRITE_FRAME_LEN];
+    rc522c_ntag_build_write_frame(frame, p->config_page + 2, report->pwd);
+    CHECK_RC522C_STATUS(s, write_frame(s, frame, report));
+    char pack_page[RC522_WRITE_LEN] = {report->pack[0], report->pack[1], 0, 0};
+    rc522c_ntag_build_write_frame(frame, p->config_page + 3, pack_page);
+    CHECK_RC522C_STATUS(s, write_frame(s, frame, report));
+    // AUTH0 goes last, so that everything else is in place once protection is on
+    CHECK_RC522C_STATUS(s, write_frame(s, p->config_frames[0], report));
+    CHECK_RC522C_STATUS(s, write_frame(s, p->config_frames[1], report));
+
+    if (image->verify)
+    {
+        char pack[RC522_PACK_LEN];
+        CHECK_RC522C_STATUS(s, rc522c_ntag_authenticate(s, report->pwd, pack));
+        if (memcmp(pack, report->pack, RC522_PACK_LEN) != 0)
+            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_VERIFY_FAILED, p->config_page + 3);
+    }
+    return RC522C_STATUS_SUCCESS;
+}
+
+enum rc522c_status rc522c_provision_tag(
+    struct rc522c_state* s, const struct rc522c_provision* p, struct rc522c_provision_report* report)
+{
+    memset(report, 0, sizeof(struct rc522c_provision_report));
+    memcpy(report->nfcid, s->tag_nfcid, NTAG_NFCID_LEN);
+    report->tag_kind = s->tag_kind;
+    report->failed_page = -1;
+    if (!s->tag_selected)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, 0);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    enum rc522c_status status = provision(s, p, report);
+    if (status == RC522C_STATUS_SUCCESS)
+        status = rc522c_ntag_halt(s);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    report->elapsed_us = (end.tv_sec - start.tv_sec) * 1000000LL + (end.tv_nsec - start.tv_nsec) / 1000;
+    return status;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "rc522c.h"
+
+// Mass provisioning: the same image is written to a long series of tags. rc522c_provision_prepare validates the image
+// once and builds the WRITE frames that are the same for every tag (data pages, CFG0, CFG1), so that
+// rc522c_provision_tag only has to derive PWD/PACK from the NFCID and send the frames back to back.
+
+struct rc522c_provision_image
+{
+    // Kind of tags being provisioned; tags of any other kind are rejected
+    enum rc522c_tag_kind tag_kind;
+    // Written to every tag from start_page on. len must be a multiple of 4; the data has to fit between the start of
+    // the user memory (page 4) and the dynamic lock bytes.
+    int start_page;
+    const char* data;
+    int len;
+
+    // Password protection (NTAG21x section 8.8), skipped if protect is 0. PWD, PACK, then CFG1 (ACCESS) and CFG0
+    // (AUTH0) are written after the data; the configuration takes effect from the next selection on.
+    // The other CFG0/CFG1 settings (mirror, NFC counter, authentication limit...) are written with their factory
+    // defaults rather than read and modified on every tag.
+    int protect;
+    // First protected page (AUTH0)
+    int auth0;
+    // 1: reading needs the password too (PROT = 1); 0: only writing does
+    int rw;
+    char pwd[RC522_PWD_LEN];
+    char pack[RC522_PACK_LEN];
+    // If 1, pwd and pack are keys XORed with the first bytes of each tag's NFCID, as NTAG21x section 8.8.1 recommends
+    // ("diversify the password and the password acknowledge"); if 0, every tag gets the same PWD and PACK
+    int diversify;
+
+    // If 1, the data is read back with FAST_READ before the tag is protected, and once it is, PWD_AUTH with the
+    // derived password has to return the derived PACK
+    int verify;
+};
+
+struct rc522c_provision
+{
+    struct rc522c_provision_image image;
+    int config_page;
+    int data_frame_count;
+    char data_frames[NTAG_MAX_PAGES][RC522C_WRITE_FRAME_LEN];
+    // CFG1 and CFG0, in the order they're written
+    char config_frames[2][RC522C_WRITE_FRAME_LEN];
+};
+
+struct rc522c_provision_report
+{
+    char nfcid[NTAG_NFCID_LEN];
+    enum rc522c_tag_kind tag_kind;
+    // The PWD and PACK the tag was given (valid if image.protect is 1)
+    char pwd[RC522_PWD_LEN];
+    char pack[RC522_PACK_LEN];
+    int pages_written;
+    // Page the sequence failed on, -1 if it didn't fail on a write
+    int failed_page;
+    // Time spent on the tag, from the first write to the halt
+    unsigned int elapsed_us;
+};
+
+// Validates image and builds p from it. image->data is copied into the frames and isn't needed afterwards.
+// Fails with RC522C_STATUS_ERROR_OUT_OF_RANGE if the data or AUTH0 don't fit the tag kind.
+enum rc522c_status rc522c_provision_prepare(
+    struct rc522c_state* s, const struct rc522c_provision_image* image, struct rc522c_provision* p);
+
+// Provisions the selected tag (e.g. one returned by rc522c_ntag_wait_for_tag) and halts it, so that it isn't
+// picked up again while it's still in the field. That only holds while the field stays on: switching it off resets
+// the tag, so wait with interval_us of at most RC522C_FIELD_GUARD_US. A tag that fails is left as it is, and is
+// picked up again by the next wait. report is filled in either way.
+enum rc522c_status rc522c_provision_tag(
+    struct rc522c_state* s, const struct rc522c_provision* p, struct rc522c_provision_report* report);
@@ -1,7 +1,19 @@
+#include "emu.h"
+#include "monitor.h"
+#include "ndef.h"
+#include "provision.h"
 #include "rc522c.h"
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
 
 static PyObject* RC522Error;
 static PyObject* RC522TagError;
@@ -9,47 +21,92 @@ static PyObject* RC522TagError;
 struct rc522
 {
     PyObject_HEAD;
+    // Serializes access to cstate, see _lock
+    PyThread_type_lock lock;
     struct rc522c_state cstate;
+    // Set by provision_setup
+    struct rc522c_provision* provision;
 };
 
-static void _raise_error(struct rc522c_state* cstate, enum rc522c_status status)
+// rc522c calls block for up to tens of milliseconds (RF timeouts, EEPROM writes), so they are made with the GIL
+// released, and each instance has a lock that serializes access to its state. The lock is only ever waited on with
+// the GIL released: a thread holding the lock can always get the GIL back.
+// Keep the lock until the error details in cstate have been turned into an exception.
+static void _lock(struct rc522* self)
+{
+    if (!PyThread_acquire_lock(self->lock, NOWAIT_LOCK))
+    {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+static void _unlock(struct rc522* self)
+{
+    PyThread_release_lock(self->lock);
+}
+
+static void _raise_status(enum rc522c_status status, int error_code, const char* error_file, int error_line)
 {
     switch (status)
     {
         break;
     case RC522C_STATUS_ERROR_PIGPIO:
-        PyErr_Format(RC522Error, "pigpio error: code %d (rc522c.c:%d)", cstate->error_code, cstate->error_line);
+        PyErr_Format(RC522Error, "pigpio error: code %d (%s:%d)", error_code, error_file, error_line);
+        break;
+    case RC522C_STATUS_ERROR_SYSTEM:
+        PyErr_Format(RC522Error, "system error: %s (%s:%d)", strerror(error_code), error_file, error_line);
         break;
     case RC522C_STATUS_ERROR_DEV_CMD_FAILED:
         PyErr_Format(
-            RC522Error, "device command failed with error %d (rc522c.c:%d)", cstate->error_code, cstate->error_line);
+            RC522Error, "device command failed with error %d (%s:%d)", error_code, error_file, error_line);
         break;
     case RC522C_STATUS_ERROR_DEV_NOT_RESPONDING:
         PyErr_Format(RC522Error, "device does not respond to commands");
         break;
     case RC522C_STATUS_ERROR_TAG_MISSING:
-        PyErr_Format(RC522TagError, "no response from the tag (rc522c.c:%d)", cstate->error_line);
+        PyErr_Format(RC522TagError, "no response from the tag (%s:%d)", error_file, error_line);
         break;
     case RC522C_STATUS_ERROR_TAG_UNSUPPORTED:
-        PyErr_Format(RC522TagError, "unsupported tag (rc522c.c:%d)", cstate->error_line);
+        PyErr_Format(RC522TagError, "unsupported tag (%s:%d)", error_file, error_line);
+        break;
+    case RC522C_STATUS_ERROR_TAG_COLLISION:
+        PyErr_Format(RC522TagError, "several tags answered at once (%s:%d)", error_file, error_line);
+        break;
+    case RC522C_STATUS_ERROR_OUT_OF_RANGE:
+        PyErr_Format(RC522TagError, "pages out of range for the selected tag (%s:%d)", error_file, error_line);
+        break;
+    case RC522C_STATUS_ERROR_VERIFY_FAILED:
+        PyErr_Format(RC522TagError, "verification failed: page %d reads back different data (%s:%d)",
+            error_code, error_file, error_line);
+        break;
+    case RC522C_STATUS_ERROR_IRQ_MISSING:
+        PyErr_Format(RC522Error,
+            "no interrupt arrived on IRQ pin %d: check the wiring, or leave irq_pin out to poll the chip instead",
+            error_code);
+        break;
+    case RC522C_STATUS_ERROR_NDEF_INVALID:
+        PyErr_Format(RC522TagError, "no valid NDEF message on the tag, parsing stopped at byte %d (%s:%d)",
+            error_code, error_file, error_line);
         break;
     case RC522C_STATUS_ERROR_TAG_NAK: {
-        switch (cstate->error_code)
+        switch (error_code)
         {
         case NTAG_NAK_INVALID_ARG:
-            PyErr_Format(RC522TagError, "NAK: invalid command argument (rc522c.c:%d)", cstate->error_line);
+            PyErr_Format(RC522TagError, "NAK: invalid command argument (%s:%d)", error_file, error_line);
             break;
         case NTAG_NAK_CRC_ERROR:
-            PyErr_Format(RC522TagError, "NAK: parity or CRC error (rc522c.c:%d)", cstate->error_line);
+            PyErr_Format(RC522TagError, "NAK: parity or CRC error (%s:%d)", error_file, error_line);
             break;
         case NTAG_NAK_AUTH_CTR_OVERLOW:
-            PyErr_Format(RC522TagError, "NAK: authentication counter overflow (rc522c.c:%d)", cstate->error_line);
+            PyErr_Format(RC522TagError, "NAK: authentication counter overflow (%s:%d)", error_file, error_line);
             break;
         case NTAG_NAK_WRITE_ERROR:
-            PyErr_Format(RC522TagError, "NAK: write error (rc522c.c:%d)", cstate->error_line);
+            PyErr_Format(RC522TagError, "NAK: write error (%s:%d)", error_file, error_line);
             break;
         default:
-            PyErr_Format(RC522TagError, "NAK: %d (rc522c.c:%d)", cstate->error_code, cstate->error_line);
+            PyErr_Format(RC522TagError, "NAK: %d (%s:%d)", error_code, error_file, error_line);
             break;
         }
         break;
@@ -57,228 +114,2242 @@ static void _raise_error(struct rc522c_state* cstate, enum rc522c_status status)
     default:
         PyErr_Format(
             RC522Error,
-            "unhandled status code %d in Python interface (internal error code %d, encountered at rc522c.c:%d)",
-            (int)status, cstate->error_code, cstate->error_line);
+            "unhandled status code %d in Python interface (internal error code %d, encountered at %s:%d)",
+            (int)status, error_code, error_file, error_line);
         break;
     }
 }
 
+static void _raise_error(struct rc522c_state* cstate, enum rc522c_status status)
+{
+    _raise_status(status, cstate->error_code, cstate->error_file, cstate->error_line);
+}
+
+// The methods called in polling loops take positional arguments only and use METH_FASTCALL (or METH_O), which saves
+// building an argument tuple and running the format string parser on every call
+static int _check_nargs(const char* name, Py_ssize_t nargs, Py_ssize_t expected)
+{
+    if (nargs == expected)
+        return 0;
+    PyErr_Format(PyExc_TypeError, "%s() takes exactly %zd arguments (%zd given)", name, expected, nargs);
+    return -1;
+}
+
+static int _arg_int(PyObject* arg, int* out)
+{
+    long value = PyLong_AsLong(arg);
+    if (value == -1 && PyErr_Occurred())
+        return -1;
+    if (value < INT_MIN || value > INT_MAX)
+    {
+        PyErr_SetString(PyExc_OverflowError, "signed integer is greater than maximum");
+        return -1;
+    }
+    *out = value;
+    return 0;
+}
+
+// Gets the contents of any contiguous bytes-like object without copying it. For compatibility with the "s#" format
+// used before, str is accepted too and stands for its UTF-8 encoding. The view keeps the object from being resized
+// until it's released with PyBuffer_Release, so it can be used with the GIL released.
+static int _get_data(PyObject* obj, Py_buffer* view)
+{
+    if (PyUnicode_Check(obj))
+    {
+        Py_ssize_t len;
+        const char* data = PyUnicode_AsUTF8AndSize(obj, &len);
+        if (!data)
+            return -1;
+        return PyBuffer_FillInfo(view, obj, (void*)data, len, 1, PyBUF_SIMPLE);
+    }
+    return PyObject_GetBuffer(obj, view, PyBUF_SIMPLE);
+}
+
+// Copies a short fixed-size argument (password, PACK, NFCID), raising ValueError with message if its size is wrong
+static int _copy_data(PyObject* obj, char* out, Py_ssize_t len, const char* message)
+{
+    Py_buffer view;
+    if (_get_data(obj, &view) < 0)
+        return -1;
+    Py_ssize_t view_len = view.len;
+    if (view_len == len)
+        memcpy(out, view.buf, len);
+    PyBuffer_Release(&view);
+    if (view_len != len)
+    {
+        PyErr_SetString(PyExc_ValueError, message);
+        return -1;
+    }
+    return 0;
+}
+
+static int _check_page_range(int start_page, int end_page)
+{
+    if (start_page < 0 || end_page > 0xFF || start_page > end_page)
+    {
+        PyErr_SetString(PyExc_ValueError, "page range must be within 0...255, with start_page <= end_page");
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject* _tag_kind_name(enum rc522c_tag_kind kind)
+{
+    switch (kind)
+    {
+    case RC522C_TAG_KIND_213:
+        return PyUnicode_FromString("NTAG213");
+    case RC522C_TAG_KIND_215:
+        return PyUnicode_FromString("NTAG215");
+    case RC522C_TAG_KIND_216:
+        return PyUnicode_FromString("NTAG216");
+    default:
+        Py_RETURN_NONE;
+    }
+}
+
+static int _parse_tag_kind(const char* name, enum rc522c_tag_kind* kind)
+{
+    if (strcmp(name, "NTAG213") == 0)
+        *kind = RC522C_TAG_KIND_213;
+    else if (strcmp(name, "NTAG215") == 0)
+        *kind = RC522C_TAG_KIND_215;
+    else if (strcmp(name, "NTAG216") == 0)
+        *kind = RC522C_TAG_KIND_216;
+    else
+    {
+        PyErr_SetString(PyExc_ValueError, "kind can be one of 'NTAG213', 'NTAG215', or 'NTAG216'");
+        return -1;
+    }
+    return 0;
+}
+
 static PyObject* rc522_new(
     PyTypeObject* type, __attribute__((unused)) PyObject* args, __attribute__((unused)) PyObject* kwargs)
 {
     struct rc522* self = (struct rc522*)type->tp_alloc(type, 0);
+    if (!self)
+        return NULL;
+    self->lock = PyThread_allocate_lock();
+    if (!self->lock)
+    {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
     return (PyObject*)self;
 }
 
 static int rc522_init(struct rc522* self, PyObject* args, PyObject* kwargs)
 {
-    static char* kwlist[] = {"spi_baud_rate", "antenna_gain", "rst_pin", NULL};
-    int spi_baud_rate, antenna_gain, rst_pin;
+    static char* kwlist[] = {"spi_baud_rate", "antenna_gain", "rst_pin", "irq_pin", "transport", "spi_device",
+        "gpio_chip", "spi_channel", "spi_aux", "hw_crc", NULL};
+    struct rc522c_config cfg = {.irq_pin = -1};
+    const char* transport = "pigpio";
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iii|isssipp", kwlist, &cfg.spi_baud_rate, &cfg.antenna_gain,
+            &cfg.rst_pin, &cfg.irq_pin, &transport, &cfg.spi_device, &cfg.gpio_chip, &cfg.spi_channel, &cfg.spi_aux,
+            &cfg.hw_crc))
+        return -1;
+
+    if (cfg.spi_baud_rate < 0)
+    {
+        PyErr_Format(PyExc_ValueError, "Invalid spi_baud_rate value %d: pass SPI_BAUD_AUTO (0) to tune it automatically",
+            cfg.spi_baud_rate);
+        return -1;
+    }
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iii", kwlist, &spi_baud_rate, &antenna_gain, &rst_pin))
+    // Raspberry Pi: the main SPI bus has CE0 and CE1, the auxiliary one has CE0...CE2
+    int max_spi_channel = cfg.spi_aux ? 2 : 1;
+    if (cfg.spi_channel < 0 || cfg.spi_channel > max_spi_channel)
+    {
+        PyErr_Format(PyExc_ValueError, "Invalid spi_channel value %d: supported values are 0...%d", cfg.spi_channel,
+            max_spi_channel);
         return -1;
+    }
 
-    if (antenna_gain < 0 || antenna_gain > 7)
+    if (cfg.antenna_gain < 0 || cfg.antenna_gain > 7)
     {
         PyErr_Format(
             RC522Error,
             "Invalid antenna_gain value %d: supported values are 0...7. See the MFRC522 datasheet, section 9.3.3.6",
-            antenna_gain);
+            cfg.antenna_gain);
         return -1;
     }
 
-    enum rc522c_status status = rc522c_init(&self->cstate, spi_baud_rate, antenna_gain, rst_pin);
-    if (status != RC522C_STATUS_SUCCESS)
+    if (strcmp(transport, "pigpio") == 0)
     {
-        _raise_error(&self->cstate, status);
+        cfg.transport = RC522C_TRANSPORT_PIGPIO;
+    }
+    else if (strcmp(transport, "spidev") == 0)
+    {
+        cfg.transport = RC522C_TRANSPORT_SPIDEV;
+    }
+    else if (strcmp(transport, "emulator") == 0)
+    {
+        cfg.transport = RC522C_TRANSPORT_EMULATOR;
+    }
+    else
+    {
+        PyErr_SetString(PyExc_ValueError, "transport can be one of 'pigpio', 'spidev', or 'emulator'");
         return -1;
     }
 
-    return 0;
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_init(&self->cstate, &cfg);
+    Py_END_ALLOW_THREADS
+    if (status != RC522C_STATUS_SUCCESS)
+        _raise_error(&self->cstate, status);
+    _unlock(self);
+
+    return status == RC522C_STATUS_SUCCESS ? 0 : -1;
 }
 
 static void rc522_dealloc(struct rc522* self)
 {
-    rc522c_deinit(&self->cstate);
+    // No other references are left, so nothing else can hold the lock
+    if (self->lock)
+    {
+        rc522c_deinit(&self->cstate);
+        PyThread_free_lock(self->lock);
+    }
+    free(self->provision);
+    Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
 static PyObject* rc522_ntag_try_select(struct rc522* self, PyObject* Py_UNUSED(ignored))
 {
-    enum rc522c_status status = rc522c_ntag_select(&self->cstate);
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_select(&self->cstate);
+    Py_END_ALLOW_THREADS
+
+    PyObject* result;
     switch (status)
     {
     case RC522C_STATUS_SUCCESS:
-        Py_RETURN_TRUE;
+        result = Py_True;
+        break;
     case RC522C_STATUS_ERROR_TAG_MISSING:
     case RC522C_STATUS_ERROR_TAG_UNSUPPORTED:
-        Py_RETURN_FALSE;
+    case RC522C_STATUS_ERROR_TAG_COLLISION:
+        result = Py_False;
+        break;
     default:
         _raise_error(&self->cstate, status);
-        return NULL;
+        result = NULL;
+        break;
+    }
+    _unlock(self);
+
+    Py_XINCREF(result);
+    return result;
+}
+
+static PyObject* rc522_ntag_try_reselect(struct rc522* self, PyObject* Py_UNUSED(ignored))
+{
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_reselect(&self->cstate);
+    Py_END_ALLOW_THREADS
+
+    PyObject* result;
+    switch (status)
+    {
+    case RC522C_STATUS_SUCCESS:
+        result = Py_True;
+        break;
+    case RC522C_STATUS_ERROR_TAG_MISSING:
+    case RC522C_STATUS_ERROR_TAG_UNSUPPORTED:
+    case RC522C_STATUS_ERROR_TAG_COLLISION:
+        result = Py_False;
+        break;
+    default:
+        _raise_error(&self->cstate, status);
+        result = NULL;
+        break;
     }
+    _unlock(self);
+
+    Py_XINCREF(result);
+    return result;
 }
 
-static PyObject* rc522_ntag_read(struct rc522* self, PyObject* args)
+static PyObject* rc522_ntag_try_select_nfcid(struct rc522* self, PyObject* arg)
 {
-    int from_page;
-    if (!PyArg_ParseTuple(args, "i", &from_page))
+    Py_buffer nfcid;
+    if (PyObject_GetBuffer(arg, &nfcid, PyBUF_SIMPLE) < 0)
+        return NULL;
+    if (nfcid.len != NTAG_NFCID_LEN)
+    {
+        PyBuffer_Release(&nfcid);
+        PyErr_SetString(PyExc_ValueError, "NFCID is required to be 7 bytes long");
         return NULL;
+    }
+
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_select_nfcid(&self->cstate, nfcid.buf);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&nfcid);
+
+    PyObject* result;
+    switch (status)
+    {
+    case RC522C_STATUS_SUCCESS:
+        result = Py_True;
+        break;
+    case RC522C_STATUS_ERROR_TAG_MISSING:
+    case RC522C_STATUS_ERROR_TAG_UNSUPPORTED:
+    case RC522C_STATUS_ERROR_TAG_COLLISION:
+        result = Py_False;
+        break;
+    default:
+        _raise_error(&self->cstate, status);
+        result = NULL;
+        break;
+    }
+    _unlock(self);
+
+    Py_XINCREF(result);
+    return result;
+}
+
+// Stack of tickets: more than this many tags in the field at once is unlikely to be readable anyway
+#define RC522_INVENTORY_MAX 32
 
-    char data[RC522_READ_LEN];
-    enum rc522c_status status = rc522c_ntag_read(&self->cstate, from_page, data);
+static PyObject* rc522_ntag_inventory(struct rc522* self, PyObject* Py_UNUSED(ignored))
+{
+    struct rc522c_ntag_info tags[RC522_INVENTORY_MAX];
+    int count;
+
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_inventory(&self->cstate, tags, RC522_INVENTORY_MAX, &count);
+    Py_END_ALLOW_THREADS
+    if (status != RC522C_STATUS_SUCCESS)
+        _raise_error(&self->cstate, status);
+    _unlock(self);
     if (status != RC522C_STATUS_SUCCESS)
+        return NULL;
+
+    PyObject* result = PyList_New(count);
+    if (!result)
+        return NULL;
+    for (int i = 0; i < count; i++)
+    {
+        PyObject* entry =
+            Py_BuildValue("(y#N)", tags[i].nfcid, (Py_ssize_t)NTAG_NFCID_LEN, _tag_kind_name(tags[i].kind));
+        if (!entry)
+        {
+            Py_DECREF(result);
+            return NULL;
+        }
+        PyList_SET_ITEM(result, i, entry);
+    }
+    return result;
+}
+
+static PyObject* rc522_ntag_present(struct rc522* self, PyObject* Py_UNUSED(ignored))
+{
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_present(&self->cstate);
+    Py_END_ALLOW_THREADS
+
+    PyObject* result;
+    switch (status)
     {
+    case RC522C_STATUS_SUCCESS:
+        result = Py_True;
+        break;
+    case RC522C_STATUS_ERROR_TAG_MISSING:
+    case RC522C_STATUS_ERROR_TAG_UNSUPPORTED:
+    case RC522C_STATUS_ERROR_TAG_NAK:
+        result = Py_False;
+        break;
+    default:
+        _raise_error(&self->cstate, status);
+        result = NULL;
+        break;
+    }
+    _unlock(self);
+
+    Py_XINCREF(result);
+    return result;
+}
+
+// Reads into out, which may be the storage of a bytes object being built or a caller's buffer. Returns -1 with an
+// exception set on failure.
+static int _ntag_read(struct rc522* self, int from_page, char* out)
+{
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_read(&self->cstate, from_page, out);
+    Py_END_ALLOW_THREADS
+    if (status != RC522C_STATUS_SUCCESS)
+        _raise_error(&self->cstate, status);
+    _unlock(self);
+
+    return status == RC522C_STATUS_SUCCESS ? 0 : -1;
+}
+
+static int _ntag_read_range(struct rc522* self, int start_page, int end_page, char* out)
+{
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_read_range(&self->cstate, start_page, end_page, out);
+    Py_END_ALLOW_THREADS
+    if (status != RC522C_STATUS_SUCCESS)
         _raise_error(&self->cstate, status);
+    _unlock(self);
+
+    return status == RC522C_STATUS_SUCCESS ? 0 : -1;
+}
+
+static PyObject* rc522_ntag_read(struct rc522* self, PyObject* const* args, Py_ssize_t nargs)
+{
+    int from_page;
+    if (_check_nargs("ntag_read", nargs, 1) < 0 || _arg_int(args[0], &from_page) < 0)
+        return NULL;
+
+    PyObject* data = PyBytes_FromStringAndSize(NULL, RC522_READ_LEN);
+    if (!data)
+        return NULL;
+    if (_ntag_read(self, from_page, PyBytes_AS_STRING(data)) < 0)
+    {
+        Py_DECREF(data);
+        return NULL;
+    }
+    return data;
+}
+
+static PyObject* rc522_ntag_read_into(struct rc522* self, PyObject* const* args, Py_ssize_t nargs)
+{
+    int from_page;
+    if (_check_nargs("ntag_read_into", nargs, 2) < 0 || _arg_int(args[0], &from_page) < 0)
+        return NULL;
+
+    Py_buffer out;
+    if (PyObject_GetBuffer(args[1], &out, PyBUF_WRITABLE) < 0)
+        return NULL;
+    if (out.len < RC522_READ_LEN)
+    {
+        PyBuffer_Release(&out);
+        PyErr_SetString(PyExc_ValueError, "buffer must be at least 16 bytes long");
+        return NULL;
+    }
+
+    int ret = _ntag_read(self, from_page, out.buf);
+    PyBuffer_Release(&out);
+    return ret < 0 ? NULL : PyLong_FromLong(RC522_READ_LEN);
+}
+
+static PyObject* rc522_ntag_read_range(struct rc522* self, PyObject* const* args, Py_ssize_t nargs)
+{
+    int start_page, end_page;
+    if (_check_nargs("ntag_read_range", nargs, 2) < 0 || _arg_int(args[0], &start_page) < 0 ||
+        _arg_int(args[1], &end_page) < 0 || _check_page_range(start_page, end_page) < 0)
+        return NULL;
+
+    PyObject* data = PyBytes_FromStringAndSize(NULL, (end_page - start_page + 1) * 4);
+    if (!data)
+        return NULL;
+    if (_ntag_read_range(self, start_page, end_page, PyBytes_AS_STRING(data)) < 0)
+    {
+        Py_DECREF(data);
+        return NULL;
+    }
+    return data;
+}
+
+static PyObject* rc522_ntag_read_range_into(struct rc522* self, PyObject* const* args, Py_ssize_t nargs)
+{
+    int start_page, end_page;
+    if (_check_nargs("ntag_read_range_into", nargs, 3) < 0 || _arg_int(args[0], &start_page) < 0 ||
+        _arg_int(args[1], &end_page) < 0 || _check_page_range(start_page, end_page) < 0)
+        return NULL;
+
+    Py_buffer out;
+    if (PyObject_GetBuffer(args[2], &out, PyBUF_WRITABLE) < 0)
+        return NULL;
+    Py_ssize_t len = (end_page - start_page + 1) * 4;
+    if (out.len < len)
+    {
+        PyBuffer_Release(&out);
+        PyErr_Format(PyExc_ValueError, "buffer must be at least %zd bytes long to fit the pages", len);
         return NULL;
     }
 
-    return PyBytes_FromStringAndSize(data, RC522_READ_LEN);
+    int ret = _ntag_read_range(self, start_page, end_page, out.buf);
+    PyBuffer_Release(&out);
+    return ret < 0 ? NULL : PyLong_FromSsize_t(len);
 }
 
-static PyObject* rc522_ntag_write(struct rc522* self, PyObject* args)
+static PyObject* rc522_ntag_write(struct rc522* self, PyObject* const* args, Py_ssize_t nargs)
 {
     int page;
-    const char* data;
-    Py_ssize_t data_len;
-    if (!PyArg_ParseTuple(args, "is#", &page, &data, &data_len))
+    Py_buffer data;
+    if (_check_nargs("ntag_write", nargs, 2) < 0 || _arg_int(args[0], &page) < 0 || _get_data(args[1], &data) < 0)
         return NULL;
 
-    if (data_len != RC522_WRITE_LEN)
+    if (data.len != RC522_WRITE_LEN)
     {
+        PyBuffer_Release(&data);
         PyErr_SetString(PyExc_ValueError, "write command takes 4 bytes (1 page) of data at a time");
         return NULL;
     }
 
-    enum rc522c_status status = rc522c_ntag_write(&self->cstate, page, data);
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_write(&self->cstate, page, data.buf);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&data);
     if (status != RC522C_STATUS_SUCCESS)
     {
         _raise_error(&self->cstate, status);
+        _unlock(self);
         return NULL;
     }
+    _unlock(self);
 
     Py_RETURN_NONE;
 }
 
-static PyObject* rc522_ntag_authenticate(struct rc522* self, PyObject* args)
+static PyObject* rc522_ntag_write_range(struct rc522* self, PyObject* args, PyObject* kwargs)
 {
-    const char* pwd;
-    Py_ssize_t pwd_len;
-    if (!PyArg_ParseTuple(args, "s#", &pwd, &pwd_len))
+    int start_page;
+    PyObject* data_obj;
+    int verify = 0;
+
+    static char* kwlist[] = {"start_page", "data", "verify", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iO|p", kwlist, &start_page, &data_obj, &verify))
         return NULL;
 
-    if (pwd_len != RC522_PWD_LEN)
+    Py_buffer data;
+    if (_get_data(data_obj, &data) < 0)
+        return NULL;
+    if (start_page < 0 || data.len > NTAG_MAX_PAGES * 4)
     {
-        PyErr_SetString(PyExc_ValueError, "password is required to be 4 bytes long");
+        PyBuffer_Release(&data);
+        PyErr_SetString(PyExc_ValueError, "data must fit into the tag memory");
         return NULL;
     }
 
-    char pack[RC522_PACK_LEN];
-    enum rc522c_status status = rc522c_ntag_authenticate(&self->cstate, pwd, pack);
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_write_range(&self->cstate, start_page, data.buf, data.len, verify);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&data);
     if (status != RC522C_STATUS_SUCCESS)
     {
         _raise_error(&self->cstate, status);
+        _unlock(self);
         return NULL;
     }
+    _unlock(self);
 
-    return PyBytes_FromStringAndSize(pack, RC522_PACK_LEN);
+    Py_RETURN_NONE;
 }
 
-static PyObject* rc522_ntag_protect(struct rc522* self, PyObject* args, PyObject* kwargs)
+static PyObject* rc522_ntag_write_bytes(struct rc522* self, PyObject* const* args, Py_ssize_t nargs)
 {
-    const char* pwd;
-    const char* pack;
-    const char* mode;
-    Py_ssize_t pwd_len, pack_len;
-    int start_page;
+    int offset;
+    Py_buffer data;
+    if (_check_nargs("ntag_write_bytes", nargs, 2) < 0 || _arg_int(args[0], &offset) < 0 ||
+        _get_data(args[1], &data) < 0)
+        return NULL;
 
-    static char* kwlist[] = {"pwd", "pack", "start_page", "mode", NULL};
-    if (!PyArg_ParseTupleAndKeywords(
-            args, kwargs, "s#s#is", kwlist, &pwd, &pwd_len, &pack, &pack_len, &start_page, &mode))
+    if (offset < 0 || data.len > NTAG_MAX_PAGES * 4)
+    {
+        PyBuffer_Release(&data);
+        PyErr_SetString(PyExc_ValueError, "data must fit into the tag memory");
+        return NULL;
+    }
+
+    int pages_written;
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_write_bytes(&self->cstate, offset, data.buf, data.len, &pages_written);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&data);
+    if (status != RC522C_STATUS_SUCCESS)
+    {
+        _raise_error(&self->cstate, status);
+        _unlock(self);
+        return NULL;
+    }
+    _unlock(self);
+
+    return PyLong_FromLong(pages_written);
+}
+
+static PyObject* rc522_ntag_authenticate(struct rc522* self, PyObject* arg)
+{
+    Py_buffer pwd;
+    if (_get_data(arg, &pwd) < 0)
         return NULL;
 
-    if (pwd_len != RC522_PWD_LEN)
+    if (pwd.len != RC522_PWD_LEN)
     {
+        PyBuffer_Release(&pwd);
         PyErr_SetString(PyExc_ValueError, "password is required to be 4 bytes long");
         return NULL;
     }
-    if (pack_len != RC522_PACK_LEN)
+
+    char pack[RC522_PACK_LEN];
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_authenticate(&self->cstate, pwd.buf, pack);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&pwd);
+    if (status != RC522C_STATUS_SUCCESS)
     {
-        PyErr_SetString(PyExc_ValueError, "PACK is required to be 2 bytes long");
+        _raise_error(&self->cstate, status);
+        _unlock(self);
         return NULL;
     }
+    _unlock(self);
 
-    int rw;
+    return PyBytes_FromStringAndSize(pack, RC522_PACK_LEN);
+}
+
+static int _parse_protect_mode(const char* mode, int* rw)
+{
     if (strcmp(mode, "w") == 0)
     {
-        rw = 0;
+        *rw = 0;
     }
     else if (strcmp(mode, "rw") == 0)
     {
-        rw = 1;
+        *rw = 1;
     }
     else
     {
         PyErr_SetString(
             PyExc_ValueError,
             "mode can be either 'w' (protect write access) or 'rw' (protect both read and write access)");
-        return NULL;
+        return -1;
     }
+    return 0;
+}
+
+static PyObject* rc522_ntag_protect(struct rc522* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* pwd_obj;
+    PyObject* pack_obj;
+    const char* mode;
+    int start_page;
+
+    static char* kwlist[] = {"pwd", "pack", "start_page", "mode", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOis", kwlist, &pwd_obj, &pack_obj, &start_page, &mode))
+        return NULL;
 
-    enum rc522c_status status = rc522c_ntag_protect(&self->cstate, pwd, pack, start_page, rw);
+    char pwd[RC522_PWD_LEN], pack[RC522_PACK_LEN];
+    int rw;
+    if (_copy_data(pwd_obj, pwd, RC522_PWD_LEN, "password is required to be 4 bytes long") < 0 ||
+        _copy_data(pack_obj, pack, RC522_PACK_LEN, "PACK is required to be 2 bytes long") < 0 ||
+        _parse_protect_mode(mode, &rw) < 0)
+        return NULL;
+
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_protect(&self->cstate, pwd, pack, start_page, rw);
+    Py_END_ALLOW_THREADS
     if (status != RC522C_STATUS_SUCCESS)
     {
         _raise_error(&self->cstate, status);
+        _unlock(self);
         return NULL;
     }
+    _unlock(self);
 
     Py_RETURN_NONE;
 }
 
-static PyObject* RC522_get_dev_version(struct rc522* self, __attribute__((unused)) void* closure)
+static PyObject* rc522_ntag_ndef_read(struct rc522* self, PyObject* Py_UNUSED(ignored))
 {
-    return PyLong_FromLong(self->cstate.dev_version);
+    char msg[RC522C_NDEF_MAX_LEN];
+    int msg_len;
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ndef_read(&self->cstate, msg, &msg_len);
+    Py_END_ALLOW_THREADS
+    if (status != RC522C_STATUS_SUCCESS)
+    {
+        _raise_error(&self->cstate, status);
+        _unlock(self);
+        return NULL;
+    }
+    _unlock(self);
+
+    return PyBytes_FromStringAndSize(msg, msg_len);
+}
+
+static PyObject* rc522_ntag_ndef_write(struct rc522* self, PyObject* arg)
+{
+    Py_buffer msg;
+    if (_get_data(arg, &msg) < 0)
+        return NULL;
+    if (msg.len > RC522C_NDEF_MAX_LEN)
+    {
+        PyBuffer_Release(&msg);
+        PyErr_SetString(PyExc_ValueError, "NDEF message is too long for any NTAG21x");
+        return NULL;
+    }
+
+    int pages_written;
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ndef_write(&self->cstate, msg.buf, msg.len, &pages_written);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&msg);
+    if (status != RC522C_STATUS_SUCCESS)
+    {
+        _raise_error(&self->cstate, status);
+        _unlock(self);
+        return NULL;
+    }
+    _unlock(self);
+
+    return PyLong_FromLong(pages_written);
+}
+
+// Scripts hold a transaction or two; this bounds the stack space taken by rc522_run_script
+#define RC522_SCRIPT_MAX_OPS 32
+
+// Arguments of a script step that have to outlive the parsing
+struct _script_step
+{
+    // NFCID or password, copied since they're tiny
+    char data[NTAG_NFCID_LEN];
+    char pack[RC522_PACK_LEN];
+    // Data of a write, used in place until the script has run
+    Py_buffer view;
+    int has_view;
+};
+
+// Parses a step such as ("read", 4, 15) into op. If the step produces a value, *result is set to a bytes object that
+// op->out points into; otherwise it's set to None.
+static int _parse_script_step(PyObject* item, struct rc522c_op* op, struct _script_step* step, PyObject** result)
+{
+    if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) < 1 || !PyUnicode_Check(PyTuple_GET_ITEM(item, 0)))
+    {
+        PyErr_SetString(PyExc_TypeError, "script steps must be tuples starting with the operation name");
+        return -1;
+    }
+    const char* name = PyUnicode_AsUTF8(PyTuple_GET_ITEM(item, 0));
+    if (!name)
+        return -1;
+
+    memset(op, 0, sizeof(*op));
+    Py_INCREF(Py_None);
+    *result = Py_None;
+    PyObject* obj;
+    PyObject* pack_obj;
+    const char* mode;
+
+    if (strcmp(name, "select") == 0)
+    {
+        op->kind = RC522C_OP_SELECT;
+        return PyArg_ParseTuple(item, "s:select", &name) ? 0 : -1;
+    }
+    if (strcmp(name, "reselect") == 0)
+    {
+        op->kind = RC522C_OP_RESELECT;
+        return PyArg_ParseTuple(item, "s:reselect", &name) ? 0 : -1;
+    }
+    if (strcmp(name, "select_nfcid") == 0)
+    {
+        op->kind = RC522C_OP_SELECT_NFCID;
+        op->data = step->data;
+        if (!PyArg_ParseTuple(item, "sO:select_nfcid", &name, &obj))
+            return -1;
+        return _copy_data(obj, step->data, NTAG_NFCID_LEN, "NFCID is required to be 7 bytes long");
+    }
+    if (strcmp(name, "auth") == 0)
+    {
+        op->kind = RC522C_OP_AUTH;
+        op->data = step->data;
+        if (!PyArg_ParseTuple(item, "sO:auth", &name, &obj) ||
+            _copy_data(obj, step->data, RC522_PWD_LEN, "password is required to be 4 bytes long") < 0)
+            return -1;
+        Py_SETREF(*result, PyBytes_FromStringAndSize(NULL, RC522_PACK_LEN));
+        if (!*result)
+            return -1;
+        op->out = PyBytes_AS_STRING(*result);
+        return 0;
+    }
+    if (strcmp(name, "read") == 0)
+    {
+        op->kind = RC522C_OP_READ_RANGE;
+        if (!PyArg_ParseTuple(item, "sii:read", &name, &op->start_page, &op->end_page) ||
+            _check_page_range(op->start_page, op->end_page) < 0)
+            return -1;
+        Py_SETREF(*result, PyBytes_FromStringAndSize(NULL, (op->end_page - op->start_page + 1) * 4));
+        if (!*result)
+            return -1;
+        op->out = PyBytes_AS_STRING(*result);
+        return 0;
+    }
+    if (strcmp(name, "write") == 0)
+    {
+        op->kind = RC522C_OP_WRITE_RANGE;
+        if (!PyArg_ParseTuple(item, "siO|p:write", &name, &op->start_page, &obj, &op->flag) ||
+            _get_data(obj, &step->view) < 0)
+            return -1;
+        step->has_view = 1;
+        if (op->start_page < 0 || step->view.len > NTAG_MAX_PAGES * 4)
+        {
+            PyErr_SetString(PyExc_ValueError, "data must fit into the tag memory");
+            return -1;
+        }
+        op->data = step->view.buf;
+        op->len = step->view.len;
+        return 0;
+    }
+    if (strcmp(name, "protect") == 0)
+    {
+        op->kind = RC522C_OP_PROTECT;
+        op->data = step->data;
+        op->pack = step->pack;
+        if (!PyArg_ParseTuple(item, "sOOis:protect", &name, &obj, &pack_obj, &op->start_page, &mode))
+            return -1;
+        if (_copy_data(obj, step->data, RC522_PWD_LEN, "password is required to be 4 bytes long") < 0 ||
+            _copy_data(pack_obj, step->pack, RC522_PACK_LEN, "PACK is required to be 2 bytes long") < 0)
+            return -1;
+        return _parse_protect_mode(mode, &op->flag);
+    }
+
+    PyErr_Format(PyExc_ValueError, "unknown script operation '%s'", name);
+    return -1;
+}
+
+// Turns a failure status into the exception the corresponding method would have raised, without raising it
+static PyObject* _status_exception(struct rc522c_state* cstate, enum rc522c_status status)
+{
+    PyObject *type, *value, *traceback;
+    _raise_error(cstate, status);
+    PyErr_Fetch(&type, &value, &traceback);
+    PyErr_NormalizeException(&type, &value, &traceback);
+    Py_XDECREF(type);
+    Py_XDECREF(traceback);
+    return value;
+}
+
+static PyObject* rc522_run_script(struct rc522* self, PyObject* arg)
+{
+    PyObject* seq = PySequence_Fast(arg, "script must be a sequence of steps");
+    if (!seq)
+        return NULL;
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    if (n > RC522_SCRIPT_MAX_OPS)
+    {
+        Py_DECREF(seq);
+        PyErr_Format(PyExc_ValueError, "scripts are limited to %d steps", RC522_SCRIPT_MAX_OPS);
+        return NULL;
+    }
+
+    struct rc522c_op ops[RC522_SCRIPT_MAX_OPS];
+    struct _script_step steps[RC522_SCRIPT_MAX_OPS];
+    PyObject* results = PyList_New(n);
+    PyObject* failed = NULL;
+    Py_ssize_t parsed = 0;
+    if (!results)
+        goto out;
+    for (; parsed < n; parsed++)
+    {
+        PyObject* result = NULL;
+        steps[parsed].has_view = 0;
+        int ret = _parse_script_step(PySequence_Fast_GET_ITEM(seq, parsed), &ops[parsed], &steps[parsed], &result);
+        if (result)
+            PyList_SET_ITEM(results, parsed, result);
+        if (ret < 0)
+        {
+            parsed++;
+            Py_CLEAR(results);
+            goto out;
+        }
+    }
+
+    int failed_index;
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_run_script(&self->cstate, ops, n, &failed_index);
+    Py_END_ALLOW_THREADS
+    if (status != RC522C_STATUS_SUCCESS)
+    {
+        PyObject* exception = _status_exception(&self->cstate, status);
+        failed = exception ? Py_BuildValue("(iN)", failed_index, exception) : NULL;
+    }
+    _unlock(self);
+
+    if (status != RC522C_STATUS_SUCCESS)
+    {
+        if (!failed)
+        {
+            Py_CLEAR(results);
+            goto out;
+        }
+        // Whatever the failed step and the ones after it would have returned is not valid
+        for (Py_ssize_t i = failed_index; i < n; i++)
+        {
+            Py_INCREF(Py_None);
+            PyList_SetItem(results, i, Py_None);
+        }
+    }
+    else
+    {
+        Py_INCREF(Py_None);
+        failed = Py_None;
+    }
+
+out:
+    for (Py_ssize_t i = 0; i < parsed; i++)
+    {
+        if (steps[i].has_view)
+            PyBuffer_Release(&steps[i].view);
+    }
+    Py_DECREF(seq);
+    if (!results)
+        return NULL;
+    return Py_BuildValue("(NN)", results, failed);
+}
+
+static struct rc522c_emu* _get_emu(struct rc522* self)
+{
+    if (self->cstate.transport_kind != RC522C_TRANSPORT_EMULATOR || !self->cstate.transport)
+    {
+        PyErr_SetString(RC522Error, "this method is only available with transport='emulator'");
+        return NULL;
+    }
+    return self->cstate.tr.emu.emu;
+}
+
+static int _parse_emu_tag(PyObject* args, PyObject* kwargs, enum rc522c_tag_kind* kind, const char** nfcid)
+{
+    const char* kind_name = "NTAG215";
+    Py_ssize_t nfcid_len = NTAG_NFCID_LEN;
+
+    static char* kwlist[] = {"kind", "nfcid", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|sy#", kwlist, &kind_name, nfcid, &nfcid_len))
+        return -1;
+    if (_parse_tag_kind(kind_name, kind) < 0)
+        return -1;
+    if (nfcid_len != NTAG_NFCID_LEN)
+    {
+        PyErr_SetString(PyExc_ValueError, "NFCID is required to be 7 bytes long");
+        return -1;
+    }
+    return 0;
+}
+
+// wait_for_tag runs rc522c_ntag_wait_for_tag in slices of about this length, unlocking the reader in between so that
+// other threads get through, and checking for signals (sync) or cancellation (async). Slices are whole multiples of
+// the interval so that the probes stay evenly spaced.
+#define RC522_WAIT_SLICE_US 20000
+
+static int _wait_slice_us(int interval_us)
+{
+    if (interval_us <= 0)
+        return RC522_WAIT_SLICE_US;
+    if (interval_us >= RC522_WAIT_SLICE_US)
+        return interval_us;
+    return interval_us * (RC522_WAIT_SLICE_US / interval_us);
+}
+
+// Parses the timeout (seconds, None = forever) and interval arguments of wait_for_tag and provision_next
+static int _parse_wait_args(PyObject* timeout_obj, double interval, double* timeout, int* interval_us)
+{
+    *timeout = -1;
+    if (timeout_obj != Py_None)
+    {
+        *timeout = PyFloat_AsDouble(timeout_obj);
+        if (*timeout == -1 && PyErr_Occurred())
+            return -1;
+        if (*timeout < 0)
+        {
+            PyErr_SetString(PyExc_ValueError, "timeout must be non-negative or None");
+            return -1;
+        }
+    }
+    if (interval < 0 || interval > 60)
+    {
+        PyErr_SetString(PyExc_ValueError, "interval must be within 0...60 seconds");
+        return -1;
+    }
+    *interval_us = interval * 1000000;
+    return 0;
+}
+
+// Returns 1 once a tag has been selected, with the reader still locked so that the caller can talk to the tag before
+// anyone else does; 0 on timeout and -1 with an exception set on failure, with the reader unlocked
+static int _wait_for_tag(struct rc522* self, double timeout, int interval_us)
+{
+    long long left_us = timeout * 1000000;
+    for (;;)
+    {
+        int slice_us = _wait_slice_us(interval_us);
+        if (timeout >= 0 && left_us < slice_us)
+            slice_us = left_us;
+
+        enum rc522c_status status;
+        _lock(self);
+        Py_BEGIN_ALLOW_THREADS
+        status = rc522c_ntag_wait_for_tag(&self->cstate, slice_us, interval_us);
+        Py_END_ALLOW_THREADS
+        if (status == RC522C_STATUS_SUCCESS)
+            return 1;
+        if (status != RC522C_STATUS_ERROR_TAG_MISSING)
+        {
+            _raise_error(&self->cstate, status);
+            _unlock(self);
+            return -1;
+        }
+        _unlock(self);
+
+        left_us -= slice_us;
+        if (timeout >= 0 && left_us <= 0)
+            return 0;
+        if (PyErr_CheckSignals() < 0)
+            return -1;
+    }
+}
+
+static PyObject* rc522_wait_for_tag(struct rc522* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* timeout_obj = Py_None;
+    double interval = 0.05;
+    static char* kwlist[] = {"timeout", "interval", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Od", kwlist, &timeout_obj, &interval))
+        return NULL;
+    double timeout;
+    int interval_us;
+    if (_parse_wait_args(timeout_obj, interval, &timeout, &interval_us) < 0)
+        return NULL;
+
+    int found = _wait_for_tag(self, timeout, interval_us);
+    if (found < 0)
+        return NULL;
+    if (found)
+        _unlock(self);
+    return PyBool_FromLong(found);
+}
+
+static PyObject* rc522_provision_setup(struct rc522* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* data_obj;
+    const char* kind_name = "NTAG215";
+    PyObject* pwd_obj = Py_None;
+    PyObject* pack_obj = Py_None;
+    const char* mode = "rw";
+    struct rc522c_provision_image image = {.start_page = NDEF_DATA_START_PAGE, .auth0 = -1, .diversify = 1, .verify = 1};
+
+    static char* kwlist[] = {
+        "data", "start_page", "tag_kind", "pwd", "pack", "auth0", "mode", "diversify", "verify", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|isOOispp", kwlist, &data_obj, &image.start_page, &kind_name,
+            &pwd_obj, &pack_obj, &image.auth0, &mode, &image.diversify, &image.verify))
+        return NULL;
+    if (_parse_tag_kind(kind_name, &image.tag_kind) < 0)
+        return NULL;
+    if (pwd_obj != Py_None || pack_obj != Py_None)
+    {
+        image.protect = 1;
+        if (_copy_data(pwd_obj, image.pwd, RC522_PWD_LEN, "password is required to be 4 bytes long") < 0 ||
+            _copy_data(pack_obj, image.pack, RC522_PACK_LEN, "PACK is required to be 2 bytes long") < 0 ||
+            _parse_protect_mode(mode, &image.rw) < 0)
+            return NULL;
+        // Protect the data being written, unless told otherwise
+        if (image.auth0 < 0)
+            image.auth0 = image.start_page;
+    }
+
+    Py_buffer data;
+    if (_get_data(data_obj, &data) < 0)
+        return NULL;
+    if (data.len % 4 != 0 || data.len > NTAG_MAX_PAGES * 4)
+    {
+        PyBuffer_Release(&data);
+        PyErr_SetString(PyExc_ValueError, "data must consist of whole pages (a multiple of 4 bytes)");
+        return NULL;
+    }
+    image.data = data.buf;
+    image.len = data.len;
+
+    struct rc522c_provision* p = malloc(sizeof(struct rc522c_provision));
+    if (!p)
+    {
+        PyBuffer_Release(&data);
+        return PyErr_NoMemory();
+    }
+    enum rc522c_status status;
+    _lock(self);
+    status = rc522c_provision_prepare(&self->cstate, &image, p);
+    PyBuffer_Release(&data);
+    if (status != RC522C_STATUS_SUCCESS)
+    {
+        free(p);
+        _raise_error(&self->cstate, status);
+        _unlock(self);
+        return NULL;
+    }
+    free(self->provision);
+    self->provision = p;
+    _unlock(self);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject* rc522_provision_next(struct rc522* self, PyObject* args, PyObject* kwargs)
+{
+    PyObject* timeout_obj = Py_None;
+    double interval = 0.005;
+    static char* kwlist[] = {"timeout", "interval", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Od", kwlist, &timeout_obj, &interval))
+        return NULL;
+    double timeout;
+    int interval_us;
+    if (_parse_wait_args(timeout_obj, interval, &timeout, &interval_us) < 0)
+        return NULL;
+    // Provisioned tags are halted, and only stay that way as long as the field isn't switched off between probes
+    if (interval_us > RC522C_FIELD_GUARD_US)
+    {
+        PyErr_SetString(PyExc_ValueError, "interval must be within 0...0.005 seconds, so that the field stays on");
+        return NULL;
+    }
+    if (!self->provision)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "provision_setup has to be called first");
+        return NULL;
+    }
+
+    int found = _wait_for_tag(self, timeout, interval_us);
+    if (found < 0)
+        return NULL;
+    if (!found)
+        Py_RETURN_NONE;
+
+    // The reader is still locked, so the tag goes straight from selection into the sequence
+    struct rc522c_provision_report report;
+    enum rc522c_status status;
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_provision_tag(&self->cstate, self->provision, &report);
+    Py_END_ALLOW_THREADS
+    int protect = self->provision->image.protect;
+
+    // Problems with a tag end up in its report; reader errors stop the line
+    PyObject* error = Py_None;
+    switch (status)
+    {
+    case RC522C_STATUS_SUCCESS:
+        Py_INCREF(error);
+        break;
+    case RC522C_STATUS_ERROR_TAG_MISSING:
+    case RC522C_STATUS_ERROR_TAG_UNSUPPORTED:
+    case RC522C_STATUS_ERROR_TAG_NAK:
+    case RC522C_STATUS_ERROR_TAG_COLLISION:
+    case RC522C_STATUS_ERROR_VERIFY_FAILED:
+        error = _status_exception(&self->cstate, status);
+        break;
+    default:
+        _raise_error(&self->cstate, status);
+        _unlock(self);
+        return NULL;
+    }
+    _unlock(self);
+    if (!error)
+        return NULL;
+
+    PyObject* failed_page = Py_None;
+    if (report.failed_page >= 0)
+        failed_page = PyLong_FromLong(report.failed_page);
+    else
+        Py_INCREF(failed_page);
+    // y# turns NULL into None
+    return Py_BuildValue("{sy#sNsy#sy#sisNsIsN}", "nfcid", report.nfcid, (Py_ssize_t)NTAG_NFCID_LEN, "tag_kind",
+        _tag_kind_name(report.tag_kind), "pwd", protect ? report.pwd : NULL, (Py_ssize_t)RC522_PWD_LEN, "pack",
+        protect ? report.pack : NULL, (Py_ssize_t)RC522_PACK_LEN, "pages_written", report.pages_written,
+        "failed_page", failed_page, "elapsed_us", report.elapsed_us, "error", error);
+}
+
+static PyObject* rc522_recover(struct rc522* self, PyObject* Py_UNUSED(ignored))
+{
+    enum rc522c_status status;
+    _lock(self);
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_recover(&self->cstate);
+    Py_END_ALLOW_THREADS
+    if (status != RC522C_STATUS_SUCCESS)
+    {
+        _raise_error(&self->cstate, status);
+        _unlock(self);
+        return NULL;
+    }
+    _unlock(self);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject* rc522_emu_place_tag(struct rc522* self, PyObject* args, PyObject* kwargs)
+{
+    enum rc522c_tag_kind kind;
+    const char* nfcid = NULL;
+    if (_parse_emu_tag(args, kwargs, &kind, &nfcid) < 0)
+        return NULL;
+
+    struct rc522c_emu* emu = _get_emu(self);
+    if (!emu)
+        return NULL;
+    _lock(self);
+    rc522c_emu_place_tag(emu, kind, nfcid);
+    _unlock(self);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject* rc522_emu_add_tag(struct rc522* self, PyObject* args, PyObject* kwargs)
+{
+    enum rc522c_tag_kind kind;
+    const char* nfcid = NULL;
+    if (_parse_emu_tag(args, kwargs, &kind, &nfcid) < 0)
+        return NULL;
+
+    struct rc522c_emu* emu = _get_emu(self);
+    if (!emu)
+        return NULL;
+    _lock(self);
+    int ret = rc522c_emu_add_tag(emu, kind, nfcid);
+    _unlock(self);
+
+    if (ret < 0)
+    {
+        PyErr_Format(RC522Error, "the emulator supports up to %d tags in the field", RC522C_EMU_MAX_TAGS);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* rc522_emu_remove_tag(struct rc522* self, PyObject* Py_UNUSED(ignored))
+{
+    struct rc522c_emu* emu = _get_emu(self);
+    if (!emu)
+        return NULL;
+    _lock(self);
+    rc522c_emu_remove_tag(emu);
+    _unlock(self);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject* rc522_emu_set_irq_connected(struct rc522* self, PyObject* connected)
+{
+    struct rc522c_emu* emu = _get_emu(self);
+    if (!emu)
+        return NULL;
+    int flag = PyObject_IsTrue(connected);
+    if (flag < 0)
+        return NULL;
+    _lock(self);
+    emu->irq_disconnected = !flag;
+    _unlock(self);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject* _cmd_stats_to_dict(const struct rc522c_cmd_stats* c)
+{
+    PyObject* naks = PyDict_New();
+    PyObject* hist = PyList_New(RC522C_STATS_LATENCY_BUCKETS);
+    if (!naks || !hist)
+        goto error;
+    for (int code = 0; code < 16; code++)
+    {
+        if (!c->naks[code])
+            continue;
+        PyObject* key = PyLong_FromLong(code);
+        PyObject* value = PyLong_FromUnsignedLong(c->naks[code]);
+        int ret = key && value ? PyDict_SetItem(naks, key, value) : -1;
+        Py_XDECREF(key);
+        Py_XDECREF(value);
+        if (ret < 0)
+            goto error;
+    }
+    for (int i = 0; i < RC522C_STATS_LATENCY_BUCKETS; i++)
+    {
+        PyObject* value = PyLong_FromUnsignedLong(c->latency_hist[i]);
+        if (!value)
+            goto error;
+        PyList_SET_ITEM(hist, i, value);
+    }
+
+    return Py_BuildValue("{sIsIsIsIsIsIsNsIsKsIsN}", "count", c->count, "retries", c->retries, "spi_xfers", c->spi_xfers,
+        "polls", c->polls, "timeouts", c->timeouts, "collisions", c->collisions, "naks", naks, "errors", c->errors,
+        "total_us", c->total_us, "max_us", c->max_us, "latency_hist", hist);
+
+error:
+    Py_XDECREF(naks);
+    Py_XDECREF(hist);
+    return NULL;
+}
+
+static PyObject* rc522_stats(struct rc522* self, PyObject* args, PyObject* kwargs)
+{
+    int reset = 0;
+    static char* kwlist[] = {"reset", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|p", kwlist, &reset))
+        return NULL;
+
+    // Take a snapshot so that the dict isn't built while holding the lock
+    struct rc522c_stats stats;
+    _lock(self);
+    stats = self->cstate.stats;
+    if (reset)
+        rc522c_stats_reset(&self->cstate);
+    _unlock(self);
+
+    PyObject* commands = PyDict_New();
+    if (!commands)
+        return NULL;
+    for (int cmd = 0; cmd < RC522C_STATS_CMD_COUNT; cmd++)
+    {
+        if (!stats.cmds[cmd].count)
+            continue;
+        PyObject* value = _cmd_stats_to_dict(&stats.cmds[cmd]);
+        int ret = value ? PyDict_SetItemString(commands, rc522c_stats_cmd_name(cmd), value) : -1;
+        Py_XDECREF(value);
+        if (ret < 0)
+        {
+            Py_DECREF(commands);
+            return NULL;
+        }
+    }
+    return Py_BuildValue("{sIsN}", "irq_lost", stats.irq_lost, "commands", commands);
+}
+
+static PyObject* RC522_get_dev_version(struct rc522* self, __attribute__((unused)) void* closure)
+{
+    return PyLong_FromLong((unsigned char)self->cstate.dev_version);
+}
+
+static PyObject* RC522_get_spi_baud_rate(struct rc522* self, __attribute__((unused)) void* closure)
+{
+    _lock(self);
+    int spi_baud_rate = self->cstate.spi_baud_rate;
+    _unlock(self);
+    return PyLong_FromLong(spi_baud_rate);
+}
+
+static PyObject* RC522_get_spi_xfer_count(struct rc522* self, __attribute__((unused)) void* closure)
+{
+    _lock(self);
+    unsigned long spi_xfer_count = self->cstate.spi_xfer_count;
+    _unlock(self);
+    return PyLong_FromUnsignedLong(spi_xfer_count);
+}
+
+static PyObject* RC522_get_shadow(struct rc522* self, __attribute__((unused)) void* closure)
+{
+    return PyBool_FromLong(self->cstate.shadow_enabled);
+}
+
+static int RC522_set_shadow(struct rc522* self, PyObject* value, __attribute__((unused)) void* closure)
+{
+    if (!value)
+    {
+        PyErr_SetString(PyExc_TypeError, "cannot delete the shadow attribute");
+        return -1;
+    }
+    int enabled = PyObject_IsTrue(value);
+    if (enabled < 0)
+        return -1;
+    _lock(self);
+    rc522c_ntag_set_shadow(&self->cstate, enabled);
+    _unlock(self);
+    return 0;
+}
+
+static PyObject* RC522_get_tag_nfcid(struct rc522* self, __attribute__((unused)) void* closure)
+{
+    PyObject* nfcid = Py_None;
+    _lock(self);
+    if (self->cstate.tag_selected)
+        nfcid = PyBytes_FromStringAndSize(self->cstate.tag_nfcid, NTAG_NFCID_LEN);
+    else
+        Py_INCREF(nfcid);
+    _unlock(self);
+    return nfcid;
+}
+
+static PyObject* RC522_get_tag_kind(struct rc522* self, __attribute__((unused)) void* closure)
+{
+    _lock(self);
+    int tag_selected = self->cstate.tag_selected;
+    enum rc522c_tag_kind tag_kind = self->cstate.tag_kind;
+    _unlock(self);
+
+    if (tag_selected)
+        return _tag_kind_name(tag_kind);
+
+    Py_RETURN_NONE;
+}
+
+// asyncio interface. AsyncRC522 wraps an RC522 and runs its commands on a worker thread. Completions are signalled
+// through an eventfd that the event loop watches (loop.add_reader) while there are commands in flight, so
+// no executor threads are involved and the futures are resolved directly on the loop.
+
+enum rc522_job_kind
+{
+  RC522_JOB_WAIT_FOR_TAG,
+  RC522_JOB_READ_RANGE,
+  RC522_JOB_WRITE_RANGE
+};
+
+struct rc522_job
+{
+    struct rc522_job* next;
+    enum rc522_job_kind kind;
+
+    // RC522_JOB_WAIT_FOR_TAG: delay between probes, see rc522c_ntag_wait_for_tag
+    int interval_us;
+    // RC522_JOB_READ_RANGE, RC522_JOB_WRITE_RANGE
+    int start_page;
+    int end_page;
+    char* data;
+    int data_len;
+    int verify;
+
+    // Set by the future's done callback, e.g. when the awaiting task is cancelled.
+    // RC522_JOB_WAIT_FOR_TAG gives up once it sees it (or once the worker is stopped).
+    int cancelled;
+
+    // Outcome, filled in by the worker. Error details are copied out of cstate before the reader is unlocked.
+    enum rc522c_status status;
+    int error_code;
+    const char* error_file;
+    int error_line;
+    char nfcid[NTAG_NFCID_LEN];
+    // RC522_JOB_READ_RANGE: bytes object the worker reads into
+    PyObject* result;
+
+    PyObject* future;
+    // The job is owned by a capsule, referenced by the future's done callback and, until the job is delivered,
+    // by the queue
+    PyObject* capsule;
+};
+
+struct rc522_async
+{
+    PyObject_HEAD;
+    struct rc522* reader;
+    // Event loop of the first command; all commands must come from the same loop
+    PyObject* loop;
+    int efd;
+
+    pthread_t worker;
+    int worker_started;
+    // Protects everything below
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int stop;
+    struct rc522_job* queue_head;
+    struct rc522_job* queue_tail;
+    struct rc522_job* done_head;
+    struct rc522_job* done_tail;
+
+    // Jobs submitted but not delivered yet (only accessed with the GIL held). The eventfd is registered with
+    // the loop while this is nonzero, which also keeps the object alive.
+    int pending;
+};
+
+static PyTypeObject* RC522Type;
+
+static void _job_push(struct rc522_job** head, struct rc522_job** tail, struct rc522_job* job)
+{
+    job->next = NULL;
+    if (*tail)
+        (*tail)->next = job;
+    else
+        *head = job;
+    *tail = job;
+}
+
+static void _job_set_status(struct rc522_job* job, struct rc522* reader, enum rc522c_status status)
+{
+    job->status = status;
+    job->error_code = reader->cstate.error_code;
+    job->error_file = reader->cstate.error_file;
+    job->error_line = reader->cstate.error_line;
+}
+
+// Runs on the worker thread, without the GIL
+static void _job_run(struct rc522_async* self, struct rc522_job* job)
+{
+    struct rc522* reader = self->reader;
+    enum rc522c_status status;
+    switch (job->kind)
+    {
+    case RC522_JOB_WAIT_FOR_TAG:
+        for (;;)
+        {
+            if (__atomic_load_n(&job->cancelled, __ATOMIC_RELAXED) || __atomic_load_n(&self->stop, __ATOMIC_RELAXED))
+                break;
+            // The reader is unlocked between slices so that synchronous calls from other threads get through
+            PyThread_acquire_lock(reader->lock, WAIT_LOCK);
+            status = rc522c_ntag_wait_for_tag(&reader->cstate, _wait_slice_us(job->interval_us), job->interval_us);
+            _job_set_status(job, reader, status);
+            if (status == RC522C_STATUS_SUCCESS)
+                memcpy(job->nfcid, reader->cstate.tag_nfcid, NTAG_NFCID_LEN);
+            PyThread_release_lock(reader->lock);
+            if (status != RC522C_STATUS_ERROR_TAG_MISSING)
+                break;
+        }
+        break;
+    case RC522_JOB_READ_RANGE:
+        PyThread_acquire_lock(reader->lock, WAIT_LOCK);
+        status = rc522c_ntag_read_range(
+            &reader->cstate, job->start_page, job->end_page, PyBytes_AS_STRING(job->result));
+        _job_set_status(job, reader, status);
+        PyThread_release_lock(reader->lock);
+        break;
+    case RC522_JOB_WRITE_RANGE:
+        PyThread_acquire_lock(reader->lock, WAIT_LOCK);
+        status = rc522c_ntag_write_range(&reader->cstate, job->start_page, job->data, job->data_len, job->verify);
+        _job_set_status(job, reader, status);
+        PyThread_release_lock(reader->lock);
+        break;
+    }
+}
+
+static void* _async_worker(void* arg)
+{
+    struct rc522_async* self = arg;
+    pthread_mutex_lock(&self->mutex);
+    for (;;)
+    {
+        while (!self->queue_head && !self->stop)
+            pthread_cond_wait(&self->cond, &self->mutex);
+        if (self->stop)
+            break;
+
+        struct rc522_job* job = self->queue_head;
+        self->queue_head = job->next;
+        if (!self->queue_head)
+            self->queue_tail = NULL;
+        pthread_mutex_unlock(&self->mutex);
+
+        _job_run(self, job);
+
+        pthread_mutex_lock(&self->mutex);
+        _job_push(&self->done_head, &self->done_tail, job);
+        uint64_t one = 1;
+        if (write(self->efd, &one, sizeof(one)) < 0)
+        {
+            // Can only fail with EAGAIN when the counter is about to overflow, i.e. the loop already has
+            // a wakeup pending
+        }
+    }
+    pthread_mutex_unlock(&self->mutex);
+    return NULL;
 }
 
-static PyObject* RC522_get_tag_nfcid(struct rc522* self, __attribute__((unused)) void* closure)
+static void _job_destroy(PyObject* capsule)
 {
-    if (self->cstate.tag_selected)
-        return PyBytes_FromStringAndSize(self->cstate.tag_nfcid, NTAG_NFCID_LEN);
+    struct rc522_job* job = PyCapsule_GetPointer(capsule, NULL);
+    free(job->data);
+    Py_XDECREF(job->result);
+    Py_XDECREF(job->future);
+    free(job);
+}
 
+// Future done callback, bound to the job's capsule
+static PyObject* _job_on_future_done(PyObject* capsule, __attribute__((unused)) PyObject* future)
+{
+    struct rc522_job* job = PyCapsule_GetPointer(capsule, NULL);
+    __atomic_store_n(&job->cancelled, 1, __ATOMIC_RELAXED);
     Py_RETURN_NONE;
 }
 
-static PyObject* RC522_get_tag_kind(struct rc522* self, __attribute__((unused)) void* closure)
+static PyMethodDef _job_on_future_done_def = {"_on_future_done", _job_on_future_done, METH_O, NULL};
+
+// Resolves the job's future, unless it has been cancelled
+static int _job_deliver(struct rc522_job* job)
 {
-    if (self->cstate.tag_selected)
+    PyObject* done = PyObject_CallMethod(job->future, "done", NULL);
+    if (!done)
+        return -1;
+    int is_done = PyObject_IsTrue(done);
+    Py_DECREF(done);
+    if (is_done)
+        return 0;
+
+    PyObject* ret;
+    if (job->status == RC522C_STATUS_SUCCESS)
+    {
+        PyObject* result;
+        switch (job->kind)
+        {
+        case RC522_JOB_WAIT_FOR_TAG:
+            result = PyBytes_FromStringAndSize(job->nfcid, NTAG_NFCID_LEN);
+            break;
+        case RC522_JOB_READ_RANGE:
+            result = job->result;
+            Py_INCREF(result);
+            break;
+        default:
+            result = Py_None;
+            Py_INCREF(result);
+            break;
+        }
+        if (!result)
+            return -1;
+        ret = PyObject_CallMethod(job->future, "set_result", "O", result);
+        Py_DECREF(result);
+    }
+    else
+    {
+        _raise_status(job->status, job->error_code, job->error_file, job->error_line);
+        PyObject *type, *value, *traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+        PyErr_NormalizeException(&type, &value, &traceback);
+        ret = PyObject_CallMethod(job->future, "set_exception", "O", value);
+        Py_XDECREF(type);
+        Py_XDECREF(value);
+        Py_XDECREF(traceback);
+    }
+    if (!ret)
+        return -1;
+    Py_DECREF(ret);
+    return 0;
+}
+
+// Called by the event loop when the eventfd becomes readable
+static PyObject* rc522_async_complete(struct rc522_async* self, PyObject* Py_UNUSED(ignored))
+{
+    uint64_t count;
+    if (read(self->efd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        return PyErr_SetFromErrno(PyExc_OSError);
+
+    pthread_mutex_lock(&self->mutex);
+    struct rc522_job* job = self->done_head;
+    self->done_head = self->done_tail = NULL;
+    pthread_mutex_unlock(&self->mutex);
+
+    while (job)
+    {
+        struct rc522_job* next = job->next;
+        // Can only fail if the future misbehaves; keep delivering the other jobs
+        if (_job_deliver(job) < 0)
+            PyErr_WriteUnraisable(job->future);
+        // Break the future -> done callback -> capsule -> job -> future cycle
+        Py_CLEAR(job->future);
+        Py_DECREF(job->capsule);
+        self->pending--;
+        job = next;
+    }
+
+    if (self->pending == 0)
+    {
+        PyObject* ret = PyObject_CallMethod(self->loop, "remove_reader", "i", self->efd);
+        if (!ret)
+            return NULL;
+        Py_DECREF(ret);
+    }
+
+    Py_RETURN_NONE;
+}
+
+// Queues the job and returns a future for its result. Takes ownership of job.
+static PyObject* _async_submit(struct rc522_async* self, struct rc522_job* job)
+{
+    PyObject* capsule = PyCapsule_New(job, NULL, _job_destroy);
+    if (!capsule)
+    {
+        free(job->data);
+        Py_XDECREF(job->result);
+        free(job);
+        return NULL;
+    }
+
+    PyObject* asyncio = PyImport_ImportModule("asyncio");
+    if (!asyncio)
+        goto error;
+    PyObject* loop = PyObject_CallMethod(asyncio, "get_running_loop", NULL);
+    Py_DECREF(asyncio);
+    if (!loop)
+        goto error;
+    if (!self->loop)
+    {
+        self->loop = loop;
+    }
+    else
+    {
+        int same_loop = loop == self->loop;
+        Py_DECREF(loop);
+        if (!same_loop)
+        {
+            PyErr_SetString(PyExc_RuntimeError, "AsyncRC522 can only be used from one event loop");
+            goto error;
+        }
+    }
+
+    job->future = PyObject_CallMethod(self->loop, "create_future", NULL);
+    if (!job->future)
+        goto error;
+    PyObject* callback = PyCFunction_New(&_job_on_future_done_def, capsule);
+    if (!callback)
+        goto error;
+    PyObject* ret = PyObject_CallMethod(job->future, "add_done_callback", "O", callback);
+    Py_DECREF(callback);
+    if (!ret)
+        goto error;
+    Py_DECREF(ret);
+
+    if (!self->worker_started)
+    {
+        int err = pthread_create(&self->worker, NULL, _async_worker, self);
+        if (err != 0)
+        {
+            errno = err;
+            PyErr_SetFromErrno(PyExc_OSError);
+            goto error;
+        }
+        self->worker_started = 1;
+    }
+
+    if (self->pending == 0)
+    {
+        PyObject* complete = PyObject_GetAttrString((PyObject*)self, "_complete");
+        if (!complete)
+            goto error;
+        ret = PyObject_CallMethod(self->loop, "add_reader", "iO", self->efd, complete);
+        Py_DECREF(complete);
+        if (!ret)
+            goto error;
+        Py_DECREF(ret);
+    }
+    self->pending++;
+
+    // The queue's reference, released once the job is delivered
+    job->capsule = capsule;
+    Py_INCREF(capsule);
+    pthread_mutex_lock(&self->mutex);
+    _job_push(&self->queue_head, &self->queue_tail, job);
+    pthread_cond_signal(&self->cond);
+    pthread_mutex_unlock(&self->mutex);
+
+    PyObject* future = job->future;
+    Py_INCREF(future);
+    Py_DECREF(capsule);
+    return future;
+
+error:
+    Py_DECREF(capsule);
+    return NULL;
+}
+
+static struct rc522_job* _job_new(enum rc522_job_kind kind)
+{
+    struct rc522_job* job = calloc(1, sizeof(struct rc522_job));
+    if (!job)
+    {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    job->kind = kind;
+    return job;
+}
+
+static PyObject* rc522_async_wait_for_tag(struct rc522_async* self, PyObject* args, PyObject* kwargs)
+{
+    double interval = 0.02;
+    static char* kwlist[] = {"interval", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|d", kwlist, &interval))
+        return NULL;
+
+    if (interval < 0 || interval > 60)
+    {
+        PyErr_SetString(PyExc_ValueError, "interval must be within 0...60 seconds");
+        return NULL;
+    }
+
+    struct rc522_job* job = _job_new(RC522_JOB_WAIT_FOR_TAG);
+    if (!job)
+        return NULL;
+    job->interval_us = interval * 1000000;
+    return _async_submit(self, job);
+}
+
+static PyObject* rc522_async_read_range(struct rc522_async* self, PyObject* const* args, Py_ssize_t nargs)
+{
+    int start_page, end_page;
+    if (_check_nargs("read_range", nargs, 2) < 0 || _arg_int(args[0], &start_page) < 0 ||
+        _arg_int(args[1], &end_page) < 0 || _check_page_range(start_page, end_page) < 0)
+        return NULL;
+
+    struct rc522_job* job = _job_new(RC522_JOB_READ_RANGE);
+    if (!job)
+        return NULL;
+    job->start_page = start_page;
+    job->end_page = end_page;
+    job->result = PyBytes_FromStringAndSize(NULL, (end_page - start_page + 1) * 4);
+    if (!job->result)
+    {
+        free(job);
+        return NULL;
+    }
+    return _async_submit(self, job);
+}
+
+static PyObject* rc522_async_write(struct rc522_async* self, PyObject* args, PyObject* kwargs)
+{
+    int start_page;
+    PyObject* data_obj;
+    int verify = 0;
+
+    static char* kwlist[] = {"start_page", "data", "verify", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iO|p", kwlist, &start_page, &data_obj, &verify))
+        return NULL;
+
+    Py_buffer data;
+    if (_get_data(data_obj, &data) < 0)
+        return NULL;
+    if (start_page < 0 || data.len > NTAG_MAX_PAGES * 4)
+    {
+        PyBuffer_Release(&data);
+        PyErr_SetString(PyExc_ValueError, "data must fit into the tag memory");
+        return NULL;
+    }
+
+    struct rc522_job* job = _job_new(RC522_JOB_WRITE_RANGE);
+    if (!job)
+    {
+        PyBuffer_Release(&data);
+        return NULL;
+    }
+    job->start_page = start_page;
+    job->verify = verify;
+    // The caller's buffer may be modified while the job is in flight
+    job->data = malloc(data.len ? data.len : 1);
+    if (!job->data)
+    {
+        PyBuffer_Release(&data);
+        free(job);
+        return PyErr_NoMemory();
+    }
+    memcpy(job->data, data.buf, data.len);
+    job->data_len = data.len;
+    PyBuffer_Release(&data);
+    return _async_submit(self, job);
+}
+
+static PyObject* rc522_async_new(
+    PyTypeObject* type, __attribute__((unused)) PyObject* args, __attribute__((unused)) PyObject* kwargs)
+{
+    struct rc522_async* self = (struct rc522_async*)type->tp_alloc(type, 0);
+    if (!self)
+        return NULL;
+    self->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (self->efd < 0)
+    {
+        PyErr_SetFromErrno(PyExc_OSError);
+        Py_DECREF(self);
+        return NULL;
+    }
+    pthread_mutex_init(&self->mutex, NULL);
+    pthread_cond_init(&self->cond, NULL);
+    return (PyObject*)self;
+}
+
+static int rc522_async_init(struct rc522_async* self, PyObject* args, PyObject* kwargs)
+{
+    static char* kwlist[] = {"reader", NULL};
+    PyObject* reader;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!", kwlist, RC522Type, &reader))
+        return -1;
+
+    if (self->reader)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "AsyncRC522 is already initialized");
+        return -1;
+    }
+    Py_INCREF(reader);
+    self->reader = (struct rc522*)reader;
+    return 0;
+}
+
+static void rc522_async_dealloc(struct rc522_async* self)
+{
+    // Pending jobs keep the object alive through the loop's reader callback, unless the loop was closed with jobs
+    // still in flight. The worker may then be in the middle of a wait_for_tag that would never end on its own,
+    // hence the stop check in _job_run; the futures of the jobs it didn't get to are never resolved.
+    if (self->worker_started)
+    {
+        pthread_mutex_lock(&self->mutex);
+        __atomic_store_n(&self->stop, 1, __ATOMIC_RELAXED);
+        pthread_cond_signal(&self->cond);
+        pthread_mutex_unlock(&self->mutex);
+        Py_BEGIN_ALLOW_THREADS
+        pthread_join(self->worker, NULL);
+        Py_END_ALLOW_THREADS
+        struct rc522_job* lists[] = {self->queue_head, self->done_head};
+        for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++)
+        {
+            for (struct rc522_job* job = lists[i]; job;)
+            {
+                struct rc522_job* next = job->next;
+                Py_CLEAR(job->future);
+                Py_DECREF(job->capsule);
+                job = next;
+            }
+        }
+    }
+    if (self->efd >= 0)
+    {
+        close(self->efd);
+        pthread_mutex_destroy(&self->mutex);
+        pthread_cond_destroy(&self->cond);
+    }
+    Py_XDECREF(self->loop);
+    Py_XDECREF(self->reader);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+// Tag presence monitor. TagMonitor runs an rc522c_monitor on an RC522: the C thread polls the reader and pushes
+// events into the monitor's ring, and events() drains it on the calling thread without taking any lock. Every event
+// also bumps an eventfd, so the monitor can be watched with select/poll or loop.add_reader.
+
+struct rc522_monitor
+{
+    PyObject_HEAD;
+    struct rc522* reader;
+    int efd;
+    struct rc522c_monitor cmon;
+    // An error event that was popped while there were arrivals/removals to return first; raised by the next events()
+    int has_error;
+    struct rc522c_event error;
+};
+
+static void _monitor_lock(void* ctx)
+{
+    PyThread_acquire_lock(((struct rc522_monitor*)ctx)->reader->lock, WAIT_LOCK);
+}
+
+static void _monitor_unlock(void* ctx)
+{
+    PyThread_release_lock(((struct rc522_monitor*)ctx)->reader->lock);
+}
+
+static void _monitor_notify(void* ctx)
+{
+    uint64_t one = 1;
+    if (write(((struct rc522_monitor*)ctx)->efd, &one, sizeof(one)) < 0)
+    {
+        // Can only fail with EAGAIN when the counter is about to overflow, i.e. a wakeup is pending anyway
+    }
+}
+
+static PyObject* rc522_monitor_new(
+    PyTypeObject* type, __attribute__((unused)) PyObject* args, __attribute__((unused)) PyObject* kwargs)
+{
+    struct rc522_monitor* self = (struct rc522_monitor*)type->tp_alloc(type, 0);
+    if (!self)
+        return NULL;
+    self->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (self->efd < 0)
+    {
+        PyErr_SetFromErrno(PyExc_OSError);
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject*)self;
+}
+
+static int rc522_monitor_init(struct rc522_monitor* self, PyObject* args, PyObject* kwargs)
+{
+    static char* kwlist[] = {"reader", "interval", "arrive_polls", "remove_polls", NULL};
+    PyObject* reader;
+    double interval = RC522C_MONITOR_DEFAULT_INTERVAL_US / 1e6;
+    struct rc522c_monitor_config cfg = {.arrive_polls = RC522C_MONITOR_DEFAULT_ARRIVE_POLLS,
+        .remove_polls = RC522C_MONITOR_DEFAULT_REMOVE_POLLS,
+        .lock = _monitor_lock,
+        .unlock = _monitor_unlock,
+        .notify = _monitor_notify,
+        .ctx = self};
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|dii", kwlist, RC522Type, &reader, &interval,
+            &cfg.arrive_polls, &cfg.remove_polls))
+        return -1;
+
+    if (self->reader)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "TagMonitor is already initialized");
+        return -1;
+    }
+    if (interval < 0 || interval > 60)
+    {
+        PyErr_SetString(PyExc_ValueError, "interval must be within 0...60 seconds");
+        return -1;
+    }
+    if (cfg.arrive_polls < 1 || cfg.remove_polls < 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "arrive_polls and remove_polls must be at least 1");
+        return -1;
+    }
+    cfg.interval_us = interval * 1000000;
+
+    Py_INCREF(reader);
+    self->reader = (struct rc522*)reader;
+    enum rc522c_status status;
+    _lock(self->reader);
+    status = rc522c_monitor_start(&self->cmon, &self->reader->cstate, &cfg);
+    if (status != RC522C_STATUS_SUCCESS)
+    {
+        _raise_error(&self->reader->cstate, status);
+        _unlock(self->reader);
+        return -1;
+    }
+    _unlock(self->reader);
+    return 0;
+}
+
+// The monitor thread may be waiting for the reader lock, held by a thread that needs the GIL to finish its call
+static void _monitor_stop(struct rc522_monitor* self)
+{
+    Py_BEGIN_ALLOW_THREADS
+    rc522c_monitor_stop(&self->cmon);
+    Py_END_ALLOW_THREADS
+}
+
+static void rc522_monitor_dealloc(struct rc522_monitor* self)
+{
+    _monitor_stop(self);
+    if (self->efd >= 0)
+        close(self->efd);
+    Py_XDECREF(self->reader);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* rc522_monitor_events(struct rc522_monitor* self, PyObject* Py_UNUSED(ignored))
+{
+    uint64_t count;
+    if (read(self->efd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        return PyErr_SetFromErrno(PyExc_OSError);
+
+    PyObject* result = PyList_New(0);
+    if (!result)
+        return NULL;
+    struct rc522c_event ev;
+    while (!self->has_error && rc522c_event_ring_pop(&self->cmon.ring, &ev))
     {
-        switch (self->cstate.tag_kind)
+        if (ev.kind == RC522C_EVENT_ERROR)
+        {
+            self->has_error = 1;
+            self->error = ev;
+            break;
+        }
+        PyObject* entry = Py_BuildValue("(sLy#N)", ev.kind == RC522C_EVENT_ARRIVED ? "arrived" : "removed",
+            ev.timestamp_ns, ev.nfcid, (Py_ssize_t)NTAG_NFCID_LEN, _tag_kind_name(ev.tag_kind));
+        if (!entry || PyList_Append(result, entry) < 0)
         {
-        case RC522C_TAG_KIND_213:
-            return PyUnicode_FromString("NTAG213");
-        case RC522C_TAG_KIND_215:
-            return PyUnicode_FromString("NTAG215");
-        case RC522C_TAG_KIND_216:
-            return PyUnicode_FromString("NTAG216");
-        case RC522C_TAG_KIND_UNKNOWN:
-            Py_RETURN_NONE;
+            Py_XDECREF(entry);
+            Py_DECREF(result);
+            return NULL;
         }
+        Py_DECREF(entry);
+    }
+
+    if (self->has_error && PyList_GET_SIZE(result) == 0)
+    {
+        Py_DECREF(result);
+        _raise_status(self->error.status, self->error.error_code, self->error.error_file, self->error.error_line);
+        return NULL;
     }
+    return result;
+}
+
+static PyObject* rc522_monitor_fileno(struct rc522_monitor* self, PyObject* Py_UNUSED(ignored))
+{
+    return PyLong_FromLong(self->efd);
+}
 
+static PyObject* rc522_monitor_close(struct rc522_monitor* self, PyObject* Py_UNUSED(ignored))
+{
+    _monitor_stop(self);
     Py_RETURN_NONE;
 }
 
+static PyObject* TagMonitor_get_dropped(struct rc522_monitor* self, void* Py_UNUSED(closure))
+{
+    return PyLong_FromUnsignedLong(__atomic_load_n(&self->cmon.ring.dropped, __ATOMIC_RELAXED));
+}
+
+static int _compare_readers(const void* a, const void* b)
+{
+    uintptr_t x = (uintptr_t)*(struct rc522* const*)a, y = (uintptr_t)*(struct rc522* const*)b;
+    return (x > y) - (x < y);
+}
+
+static PyObject* rc522_poll_readers(PyObject* Py_UNUSED(module), PyObject* arg)
+{
+    PyObject* seq = PySequence_Fast(arg, "poll_readers expects a sequence of RC522 objects");
+    if (!seq)
+        return NULL;
+
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    if (n < 1 || n > RC522C_MULTI_MAX_READERS)
+    {
+        PyErr_Format(PyExc_ValueError, "poll_readers supports 1...%d readers", RC522C_MULTI_MAX_READERS);
+        Py_DECREF(seq);
+        return NULL;
+    }
+
+    struct rc522* readers[RC522C_MULTI_MAX_READERS];
+    struct rc522* sorted[RC522C_MULTI_MAX_READERS];
+    struct rc522c_state* cstates[RC522C_MULTI_MAX_READERS];
+    for (Py_ssize_t i = 0; i < n; i++)
+    {
+        PyObject* item = PySequence_Fast_GET_ITEM(seq, i);
+        if (!PyObject_TypeCheck(item, RC522Type))
+        {
+            PyErr_SetString(PyExc_TypeError, "poll_readers expects a sequence of RC522 objects");
+            Py_DECREF(seq);
+            return NULL;
+        }
+        readers[i] = sorted[i] = (struct rc522*)item;
+        cstates[i] = &readers[i]->cstate;
+        for (Py_ssize_t j = 0; j < i; j++)
+        {
+            if (readers[j] == readers[i])
+            {
+                PyErr_SetString(PyExc_ValueError, "poll_readers: the same reader is listed twice");
+                Py_DECREF(seq);
+                return NULL;
+            }
+        }
+    }
+
+    // Always take the locks in the same (address) order so that concurrent calls can't deadlock
+    qsort(sorted, n, sizeof(sorted[0]), _compare_readers);
+    for (Py_ssize_t i = 0; i < n; i++)
+        _lock(sorted[i]);
+
+    enum rc522c_status status;
+    int selected[RC522C_MULTI_MAX_READERS];
+    int failed;
+    Py_BEGIN_ALLOW_THREADS
+    status = rc522c_ntag_select_multi(cstates, (int)n, selected, &failed);
+    Py_END_ALLOW_THREADS
+
+    PyObject* result = NULL;
+    if (status != RC522C_STATUS_SUCCESS)
+    {
+        _raise_error(cstates[failed], status);
+    }
+    else if ((result = PyList_New(n)))
+    {
+        for (Py_ssize_t i = 0; i < n; i++)
+            PyList_SET_ITEM(result, i, PyBool_FromLong(selected[i]));
+    }
+
+    for (Py_ssize_t i = n - 1; i >= 0; i--)
+        _unlock(sorted[i]);
+    Py_DECREF(seq);
+    return result;
+}
+
 PyMODINIT_FUNC PyInit_rc522pi(void)
 {
     static PyMethodDef rc522_methods[] = {
         {"ntag_try_select", (PyCFunction)rc522_ntag_try_select, METH_NOARGS, "TODO"},
-        {"ntag_read", (PyCFunction)rc522_ntag_read, METH_VARARGS, "TODO"},
-        {"ntag_write", (PyCFunction)rc522_ntag_write, METH_VARARGS, "TODO"},
-        {"ntag_authenticate", (PyCFunction)rc522_ntag_authenticate, METH_VARARGS, "TODO"},
+        {"ntag_try_reselect", (PyCFunction)rc522_ntag_try_reselect, METH_NOARGS,
+         "Selects the last selected tag again, skipping anticollision and GET_VERSION"},
+        {"ntag_try_select_nfcid", (PyCFunction)rc522_ntag_try_select_nfcid, METH_O,
+         "Selects the tag with the given NFCID, e.g. one returned by ntag_inventory"},
+        {"ntag_inventory", (PyCFunction)rc522_ntag_inventory, METH_NOARGS,
+         "Lists the tags in the field as (nfcid, kind) tuples. The tags are left halted: "
+         "select one of them with ntag_try_select_nfcid"},
+        {"ntag_present", (PyCFunction)rc522_ntag_present, METH_NOARGS,
+         "Checks that the selected tag is still in the field without changing its state (e.g. authentication)"},
+        {"ntag_read", (PyCFunction)rc522_ntag_read, METH_FASTCALL, "TODO"},
+        {"ntag_read_into", (PyCFunction)rc522_ntag_read_into, METH_FASTCALL,
+         "Reads 4 pages starting at page into a writable buffer (e.g. a bytearray or memoryview) of at least "
+         "16 bytes instead of allocating bytes. Returns the number of bytes written"},
+        {"ntag_read_range", (PyCFunction)rc522_ntag_read_range, METH_FASTCALL,
+         "Reads pages start_page...end_page (inclusive) using FAST_READ"},
+        {"ntag_read_range_into", (PyCFunction)rc522_ntag_read_range_into, METH_FASTCALL,
+         "Reads pages start_page...end_page (inclusive) using FAST_READ into a writable buffer. "
+         "Returns the number of bytes written"},
+        {"ntag_write", (PyCFunction)rc522_ntag_write, METH_FASTCALL, "TODO"},
+        {"ntag_write_range", (PyCFunction)rc522_ntag_write_range, METH_VARARGS | METH_KEYWORDS,
+         "Writes data of any length starting at start_page, optionally reading it back for verification"},
+        {"ntag_write_bytes", (PyCFunction)rc522_ntag_write_bytes, METH_FASTCALL,
+         "Writes data at the given byte offset, skipping pages that already hold the same contents. "
+         "Returns the number of pages written"},
+        {"ntag_authenticate", (PyCFunction)rc522_ntag_authenticate, METH_O, "TODO"},
         {"ntag_protect", (PyCFunction)rc522_ntag_protect, METH_VARARGS | METH_KEYWORDS, "TODO"},
+        {"ntag_ndef_read", (PyCFunction)rc522_ntag_ndef_read, METH_NOARGS,
+         "Returns the NDEF message stored on the tag, reading only the pages it occupies"},
+        {"ntag_ndef_write", (PyCFunction)rc522_ntag_ndef_write, METH_O,
+         "Stores an NDEF message on the tag, writing only the pages that change. Returns the number of pages written"},
+        {"run_script", (PyCFunction)rc522_run_script, METH_O,
+         "Runs a list of steps with a single call, stopping at the first failure. Steps are tuples: ('select',), "
+         "('reselect',), ('select_nfcid', nfcid), ('auth', pwd), ('read', start_page, end_page), "
+         "('write', start_page, data[, verify]), ('protect', pwd, pack, start_page, mode). Returns (results, failed): "
+         "results holds the PACK for auth steps, the data for read steps and None for the rest; "
+         "failed is None, or (index, exception) for the step that failed"},
+        {"wait_for_tag", (PyCFunction)rc522_wait_for_tag, METH_VARARGS | METH_KEYWORDS,
+         "Waits until a tag enters the field and selects it. Returns False if timeout (seconds, None = forever) "
+         "passes first. The field is probed every interval seconds; intervals longer than 5 ms switch the antenna "
+         "off between probes"},
+        {"provision_setup", (PyCFunction)rc522_provision_setup, METH_VARARGS | METH_KEYWORDS,
+         "Prepares the image that provision_next writes to every tag: data (whole pages) from start_page on, and, "
+         "if pwd and pack are given, password protection from auth0 (default: start_page) on with mode 'rw' or 'w'. "
+         "With diversify, pwd and pack are XORed with each tag's NFCID. With verify, the data is read back and "
+         "the password checked"},
+        {"provision_next", (PyCFunction)rc522_provision_next, METH_VARARGS | METH_KEYWORDS,
+         "Waits for a tag like wait_for_tag (keeping the field on, so that provisioned tags stay halted), provisions "
+         "it and halts it. Returns a report dict (nfcid, tag_kind, pwd, pack, pages_written, failed_page, "
+         "elapsed_us, error), or None on timeout. Tag failures are reported in 'error' rather than raised"},
+        {"recover", (PyCFunction)rc522_recover, METH_NOARGS,
+         "Resets the chip and restores its configuration without reopening SPI/GPIO, e.g. after a device error. "
+         "Much faster than creating a new RC522. The selected tag is dropped; ntag_try_reselect brings it back"},
+        {"emu_place_tag", (PyCFunction)rc522_emu_place_tag, METH_VARARGS | METH_KEYWORDS,
+         "Emulator only: places a factory-fresh tag of the given kind into the field"},
+        {"emu_add_tag", (PyCFunction)rc522_emu_add_tag, METH_VARARGS | METH_KEYWORDS,
+         "Emulator only: places one more factory-fresh tag into the field, next to the ones already there"},
+        {"emu_remove_tag", (PyCFunction)rc522_emu_remove_tag, METH_NOARGS,
+         "Emulator only: removes all tags from the field"},
+        {"emu_set_irq_connected", (PyCFunction)rc522_emu_set_irq_connected, METH_O,
+         "Emulator only: connects or disconnects the IRQ line, e.g. to check the fallback to polling"},
+        {"stats", (PyCFunction)rc522_stats, METH_VARARGS | METH_KEYWORDS,
+         "Returns per-command counters (SPI transactions, polls, timeouts, NAKs...) and latency histograms "
+         "with power-of-two microsecond buckets. If reset is true, the counters are zeroed afterwards"},
         {NULL}};
 
     static PyGetSetDef rc522_getset[] = {
         {"dev_version", (getter)RC522_get_dev_version, NULL, "TODO", NULL},
+        {"spi_baud_rate", (getter)RC522_get_spi_baud_rate, NULL,
+         "SPI clock in use; with spi_baud_rate=SPI_BAUD_AUTO, the rate picked during initialization", NULL},
+        {"spi_xfer_count", (getter)RC522_get_spi_xfer_count, NULL,
+         "Number of SPI transactions issued since initialization", NULL},
+        {"shadow", (getter)RC522_get_shadow, (setter)RC522_set_shadow,
+         "Whether to keep a copy of the selected tag's memory for ntag_write_bytes. "
+         "Only enable it if nothing else writes to the tag while it stays selected", NULL},
         {"tag_nfcid", (getter)RC522_get_tag_nfcid, NULL, "TODO", NULL},
         {"tag_kind", (getter)RC522_get_tag_kind, NULL, "TODO", NULL},
         {NULL}};
@@ -297,7 +2368,65 @@ PyMODINIT_FUNC PyInit_rc522pi(void)
         .tp_getset = rc522_getset,
         .tp_methods = rc522_methods};
 
-    static PyMethodDef module_methods[] = {{NULL}};
+    static PyMethodDef rc522_async_methods[] = {
+        {"wait_for_tag", (PyCFunction)rc522_async_wait_for_tag, METH_VARARGS | METH_KEYWORDS,
+         "Waits until a tag enters the field and selects it, probing every interval seconds. Returns its NFCID"},
+        {"read_range", (PyCFunction)rc522_async_read_range, METH_FASTCALL,
+         "Reads pages start_page...end_page (inclusive) using FAST_READ"},
+        {"write", (PyCFunction)rc522_async_write, METH_VARARGS | METH_KEYWORDS,
+         "Writes data of any length starting at start_page, optionally reading it back for verification"},
+        {"_complete", (PyCFunction)rc522_async_complete, METH_NOARGS,
+         "Event loop callback: resolves the futures of completed commands"},
+        {NULL}};
+
+    static PyTypeObject rc522_async_type = {
+        PyVarObject_HEAD_INIT(NULL, 0)
+
+            .tp_name = "rc522pi.AsyncRC522",
+        .tp_doc = "asyncio interface to an RC522: methods return futures, which are resolved on the event loop",
+        .tp_basicsize = sizeof(struct rc522_async),
+        .tp_itemsize = 0,
+        .tp_flags = Py_TPFLAGS_DEFAULT,
+        .tp_new = rc522_async_new,
+        .tp_init = (initproc)rc522_async_init,
+        .tp_dealloc = (destructor)rc522_async_dealloc,
+        .tp_methods = rc522_async_methods};
+
+    static PyMethodDef rc522_monitor_methods[] = {
+        {"events", (PyCFunction)rc522_monitor_events, METH_NOARGS,
+         "Returns the events since the last call as (kind, timestamp_ns, nfcid, tag_kind) tuples, kind being "
+         "'arrived' or 'removed' and timestamp_ns comparable with time.monotonic_ns(). Raises the reader error "
+         "that stopped the monitor once the events before it have been returned"},
+        {"fileno", (PyCFunction)rc522_monitor_fileno, METH_NOARGS,
+         "File descriptor that becomes readable when there are new events (for select or loop.add_reader)"},
+        {"close", (PyCFunction)rc522_monitor_close, METH_NOARGS,
+         "Stops the monitor thread. Events that have already been published can still be read"},
+        {NULL}};
+
+    static PyGetSetDef rc522_monitor_getset[] = {
+        {"dropped", (getter)TagMonitor_get_dropped, NULL,
+         "Number of events discarded because events() wasn't called often enough to keep up", NULL},
+        {NULL}};
+
+    static PyTypeObject rc522_monitor_type = {
+        PyVarObject_HEAD_INIT(NULL, 0)
+
+            .tp_name = "rc522pi.TagMonitor",
+        .tp_doc = "Polls an RC522 on a background thread and reports debounced tag arrivals and removals",
+        .tp_basicsize = sizeof(struct rc522_monitor),
+        .tp_itemsize = 0,
+        .tp_flags = Py_TPFLAGS_DEFAULT,
+        .tp_new = rc522_monitor_new,
+        .tp_init = (initproc)rc522_monitor_init,
+        .tp_dealloc = (destructor)rc522_monitor_dealloc,
+        .tp_getset = rc522_monitor_getset,
+        .tp_methods = rc522_monitor_methods};
+
+    static PyMethodDef module_methods[] = {
+        {"poll_readers", rc522_poll_readers, METH_O,
+         "Tries to select a tag on each of the given readers, overlapping their REQA probes. "
+         "Returns a list of bools, one per reader"},
+        {NULL}};
 
     static struct PyModuleDef module_def = {
         PyModuleDef_HEAD_INIT,
@@ -313,6 +2442,11 @@ PyMODINIT_FUNC PyInit_rc522pi(void)
 
     if (PyType_Ready(&rc522_type) < 0)
         return NULL;
+    if (PyType_Ready(&rc522_async_type) < 0)
+        return NULL;
+    if (PyType_Ready(&rc522_monitor_type) < 0)
+        return NULL;
+    RC522Type = &rc522_type;
 
     PyObject* module = PyModule_Create(&module_def);
     if (!module)
@@ -320,6 +2454,10 @@ PyMODINIT_FUNC PyInit_rc522pi(void)
 
     Py_INCREF(&rc522_type);
     PyModule_AddObject(module, "RC522", (PyObject*)&rc522_type);
+    Py_INCREF(&rc522_async_type);
+    PyModule_AddObject(module, "AsyncRC522", (PyObject*)&rc522_async_type);
+    Py_INCREF(&rc522_monitor_type);
+    PyModule_AddObject(module, "TagMonitor", (PyObject*)&rc522_monitor_type);
 
     RC522Error = PyErr_NewExceptionWithDoc(
         "rc522pi.RC522Error",
@@ -335,6 +2473,7 @@ PyMODINIT_FUNC PyInit_rc522pi(void)
     if (!RC522TagError)
         return NULL;
     PyModule_AddObject(module, "RC522TagError", RC522TagError);
+    PyModule_AddIntConstant(module, "SPI_BAUD_AUTO", RC522C_SPI_BAUD_AUTO);
 
     return module;
 }
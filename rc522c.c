@@ -1,293 +1,1192 @@
 #include <assert.h>
-#include <pigpio.h>
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
+#include "crc.h"
+#include "internal.h"
 #include "rc522c.h"
 
-// Must run as root
 // Based on https://github.com/ondryaso/pi-rc522
-// Total/free memory: vcgencmd get_mem reloc_total/reloc
 
-// clang-format off
-#define CHECK_PIGPIO(s, expr) {int ret = expr; if (ret < 0) { s->error_line = __LINE__; s->error_code = ret; return RC522C_STATUS_ERROR_PIGPIO; }}
-#define CHECK_RC522C_STATUS(s, expr) {enum rc522c_status ret = expr; if (ret != RC522C_STATUS_SUCCESS) { return ret; }}
-#define RETURN_RC522C_ERROR(s, status, _error_code) {s->error_line = __LINE__; s->error_code = _error_code; return status;}
-// clang-format on
+void rc522c_sleep_us(int us)
+{
+    struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (long)(us % 1000000) * 1000};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+// Microseconds since start (CLOCK_MONOTONIC)
+static long long elapsed_us(const struct timespec* start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000LL + (now.tv_nsec - start->tv_nsec) / 1000;
+}
 
-int spi_write_byte(struct rc522c_state* s, char addr, char val)
+enum rc522c_status spi_write_byte(struct rc522c_state* s, char addr, char val)
 {
     // MFRC522 8.1.2, address byte consists of msb=0 to indicate reg write and lsb=0
     char tx[] = {addr << 1, val};
-    int status = spiWrite(s->spi, tx, 2);
-    return status;
+    struct rc522c_spi_xfer xfer = {tx, NULL, 2};
+    s->spi_xfer_count++;
+    return s->transport->xfer(s, &xfer, 1);
 }
 
-int spi_read_byte(struct rc522c_state* s, char addr, char* val)
+enum rc522c_status spi_read_byte(struct rc522c_state* s, char addr, char* val)
 {
     // MFRC522 8.1.2, address byte msb=1 (read), lsb=0, next byte is 0 because we only intend to read one byte
     char tx[] = {(addr << 1) | 0x80, 0};
     char rx[] = {0, 0}; // first received byte is undefined, next byte is the value
-    int status = spiXfer(s->spi, tx, rx, 2);
-    if (status > 0)
-        *val = rx[1];
-    return status;
+    struct rc522c_spi_xfer xfer = {tx, rx, 2};
+    s->spi_xfer_count++;
+    CHECK_RC522C_STATUS(s, s->transport->xfer(s, &xfer, 1));
+    *val = rx[1];
+    return RC522C_STATUS_SUCCESS;
 }
 
-enum rc522c_status init_dev(struct rc522c_state* s, int antenna_gain)
+// Register accesses that are sent to the device in a single transport call.
+// Transport backends that support it (spidev) execute the whole batch with one system call.
+struct spi_batch
 {
-    // Do a simple sanity check: version must be non-zero. If it is 0, the chip is not responding.
-    // This happens e.g. when the post-hard reset delay is too short
-    s->dev_version = 0;
-    CHECK_PIGPIO(s, spi_read_byte(s, RC522_REG_VERSION, &s->dev_version));
-    if (s->dev_version == 0)
-        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_DEV_NOT_RESPONDING, 0);
+    int n;
+    struct rc522c_spi_xfer xfers[RC522C_SPI_BATCH_MAX];
+    // Address and value bytes for each register access
+    char tx[RC522C_SPI_BATCH_MAX][2];
+    char rx[RC522C_SPI_BATCH_MAX][2];
+    // For register reads: where to store the value once the batch has been sent
+    char* read_out[RC522C_SPI_BATCH_MAX];
+    // A batch may contain one FIFO access, which needs larger buffers
+    char fifo_tx[RC522_FIFO_SIZE + 1];
+    char fifo_rx[RC522_FIFO_SIZE + 1];
+    char* fifo_out;
+    int fifo_len;
+};
+
+void spi_batch_init(struct spi_batch* b)
+{
+    b->n = 0;
+    b->fifo_out = NULL;
+}
+
+void spi_batch_write(struct spi_batch* b, char addr, char val)
+{
+    assert(b->n < RC522C_SPI_BATCH_MAX);
+    // MFRC522 8.1.2, address byte consists of msb=0 to indicate reg write and lsb=0
+    b->tx[b->n][0] = addr << 1;
+    b->tx[b->n][1] = val;
+    b->read_out[b->n] = NULL;
+    b->xfers[b->n] = (struct rc522c_spi_xfer){b->tx[b->n], NULL, 2};
+    b->n++;
+}
+
+void spi_batch_read(struct spi_batch* b, char addr, char* val)
+{
+    assert(b->n < RC522C_SPI_BATCH_MAX);
+    // MFRC522 8.1.2, address byte msb=1 (read), lsb=0, next byte is 0 because we only intend to read one byte
+    b->tx[b->n][0] = (addr << 1) | 0x80;
+    b->tx[b->n][1] = 0;
+    b->read_out[b->n] = val;
+    b->xfers[b->n] = (struct rc522c_spi_xfer){b->tx[b->n], b->rx[b->n], 2};
+    b->n++;
+}
+
+void spi_batch_write_fifo(struct spi_batch* b, const char* data, int len)
+{
+    assert(b->n < RC522C_SPI_BATCH_MAX && len <= RC522_FIFO_SIZE);
+    // MFRC522 8.1.2.2, the address byte is followed by any number of data bytes, all written to the same register
+    b->fifo_tx[0] = RC522_REG_FIFO_DATA << 1;
+    memcpy(&b->fifo_tx[1], data, len);
+    b->read_out[b->n] = NULL;
+    b->xfers[b->n] = (struct rc522c_spi_xfer){b->fifo_tx, NULL, len + 1};
+    b->n++;
+}
+
+void spi_batch_read_fifo(struct spi_batch* b, char* out, int len)
+{
+    assert(b->n < RC522C_SPI_BATCH_MAX && len <= RC522_FIFO_SIZE);
+    // MFRC522 8.1.2.1, the address byte is repeated for every byte to be read, and the last byte sent is 0.
+    // Each received byte is the value read with the previous address byte, so the first one is undefined.
+    memset(b->fifo_tx, (RC522_REG_FIFO_DATA << 1) | 0x80, len);
+    b->fifo_tx[len] = 0;
+    b->fifo_out = out;
+    b->fifo_len = len;
+    b->read_out[b->n] = NULL;
+    b->xfers[b->n] = (struct rc522c_spi_xfer){b->fifo_tx, b->fifo_rx, len + 1};
+    b->n++;
+}
 
-    // Timer pscl = 3390, reload = 30, delay = (3390*2+1)*(30+1) / 13560000Hz = 0.015s = 15ms
-    // 0x80 = timer automatically starts at the end of transmission, prescaler_hi = 0xD
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_TIMER_MODE, 0x8D));
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_TIMER_PRESCALER_LO, 0x3E));
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_TIMER_RELOAD_HI, 0));
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_TIMER_RELOAD_LO, 30));
+enum rc522c_status spi_batch_flush(struct rc522c_state* s, struct spi_batch* b)
+{
+    if (b->n == 0)
+        return RC522C_STATUS_SUCCESS;
+
+    s->spi_xfer_count += b->n;
+    CHECK_RC522C_STATUS(s, s->transport->xfer(s, b->xfers, b->n));
+
+    for (int i = 0; i < b->n; ++i)
+        if (b->read_out[i])
+            *b->read_out[i] = b->rx[i][1];
+    if (b->fifo_out)
+        memcpy(b->fifo_out, &b->fifo_rx[1], b->fifo_len);
+
+    spi_batch_init(b);
+    return RC522C_STATUS_SUCCESS;
+}
+
+// Queues the register configuration that a reset wipes out. Shared by init_dev and rc522c_recover.
+static void config_batch(struct rc522c_state* s, struct spi_batch* b)
+{
+    // Timer pscl = 67, one tick = (67*2+1) / 13560000Hz = ~10us. The reload value (the timeout) is set per command,
+    // see set_timeout.
+    // 0x80 = timer automatically starts at the end of transmission, prescaler_hi = 0
+    spi_batch_write(b, RC522_REG_TIMER_MODE, 0x80 | (RC522_TIMER_PRESCALER >> 8));
+    spi_batch_write(b, RC522_REG_TIMER_PRESCALER_LO, RC522_TIMER_PRESCALER & 0xFF);
+    s->timer_reload = -1;
+    // TxModeReg/RxModeReg are set per command, see transceive_begin
+    s->crc_mode = -1;
 
     // ??? shouldn't work, perhaps there's an error in pirc522 and 0x20 is intended?
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_TX_ASK, 0x40));
+    spi_batch_write(b, RC522_REG_TX_ASK, 0x40);
     // CRC preset = A671, MFIN is active high?, TxWaitRF
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_MODE, 0x3D));
+    spi_batch_write(b, RC522_REG_MODE, 0x3D);
+    // Drive the IRQ pin as a CMOS output rather than open drain, so that it works without an external pull-up
+    spi_batch_write(b, RC522_REG_DIV_IEN, 0x80);
 
     // Set receiver gain (higher gain => more power along narrower direction)
     // Valid values are 0...7; see MFRC522 9.3.3.6 for more information
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_RECV_GAIN, (antenna_gain << 4)));
+    spi_batch_write(b, RC522_REG_RECV_GAIN, (s->antenna_gain << 4));
+
+    // ValuesAfterColl = 0: received bits after a collision are cleared, see ntag_sdd
+    spi_batch_write(b, RC522_REG_COLL, 0x00);
+
+    // Raise HiAlert when there are only RC522_FIFO_WATER_LEVEL bytes of free space left in the FIFO
+    // so that long responses can be drained before it overflows
+    spi_batch_write(b, RC522_REG_WATER_LEVEL, RC522_FIFO_WATER_LEVEL);
+}
+
+enum rc522c_status init_dev(struct rc522c_state* s, int antenna_gain)
+{
+    // Do a simple sanity check: version must be non-zero. If it is 0, the chip is not responding.
+    // This happens e.g. when the post-hard reset delay is too short
+    s->dev_version = 0;
+    CHECK_RC522C_STATUS(s, spi_read_byte(s, RC522_REG_VERSION, &s->dev_version));
+    if (s->dev_version == 0)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_DEV_NOT_RESPONDING, 0);
+
+    struct spi_batch b;
+    spi_batch_init(&b);
+    s->antenna_gain = antenna_gain;
+    config_batch(s, &b);
 
     // Enable antennas
     char tx_state;
-    CHECK_PIGPIO(s, spi_read_byte(s, RC522_REG_TX_CTRL, &tx_state));
+    spi_batch_read(&b, RC522_REG_TX_CTRL, &tx_state);
+    CHECK_RC522C_STATUS(s, spi_batch_flush(s, &b));
+    s->tx_ctrl = tx_state | 0x03;
     if ((tx_state & 0x03) == 0)
-        CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_TX_CTRL, tx_state | 0x03));
+        CHECK_RC522C_STATUS(s, spi_write_byte(s, RC522_REG_TX_CTRL, s->tx_ctrl));
 
     return RC522C_STATUS_SUCCESS;
 }
 
-// rx _must_ be able to fit at least 64 bytes (size of FIFO buffer)
-// on success, returns number of _bits_ read to rx
-enum rc522c_status rc522c_transceive(struct rc522c_state* s, const char* tx, int tx_bits, char* rx, int* rx_bits)
+// Programs the RF timeout for the next command. The reload registers are only written when the value changes.
+void set_timeout(struct rc522c_state* s, struct spi_batch* b, int timeout_us)
 {
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_COM_IRQ, 0x7F));        // clear interrupt request
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_COM_IEN, 0x80 | 0x77)); // enable all interrupts, invert irq pin signal
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_FIFO_LEVEL, 0x80));     // clear FIFO buffer
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_CMD, RC522_CMD_IDLE));  // don't execute any commands yet
+    // delay = (pscl*2+1)*(reload+1) / 13560000Hz, rounded up to a whole number of ticks
+    const long tick_divisor = (RC522_TIMER_PRESCALER * 2 + 1) * 1000;
+    long reload = ((long)timeout_us * 13560 + tick_divisor - 1) / tick_divisor - 1;
+    if (reload < 1)
+        reload = 1;
+    if (reload > 0xFFFF)
+        reload = 0xFFFF;
+
+    if (s->timer_reload < 0 || (s->timer_reload >> 8) != (reload >> 8))
+        spi_batch_write(b, RC522_REG_TIMER_RELOAD_HI, reload >> 8);
+    if (s->timer_reload < 0 || (s->timer_reload & 0xFF) != (reload & 0xFF))
+        spi_batch_write(b, RC522_REG_TIMER_RELOAD_LO, reload & 0xFF);
+    s->timer_reload = reload;
+}
 
-    int tx_bytes = (tx_bits + 7) / 8; // ceil
+// Reads out the part of the response that is already in the FIFO
+enum rc522c_status drain_fifo(struct rc522c_state* s, char* rx, int rx_len, int* rx_drained)
+{
+    char level;
+    CHECK_RC522C_STATUS(s, spi_read_byte(s, RC522_REG_FIFO_LEVEL, &level));
+    level &= 0x7F;
+    if (*rx_drained + level > rx_len)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+
+    struct spi_batch b;
+    spi_batch_init(&b);
+    spi_batch_read_fifo(&b, &rx[*rx_drained], level);
+    CHECK_RC522C_STATUS(s, spi_batch_flush(s, &b));
+    *rx_drained += level;
+    return RC522C_STATUS_SUCCESS;
+}
+
+// Checks COM_IRQ once: sets *done if the transceive command has completed or timed out, otherwise drains long
+// responses from the FIFO. *irq_acked is set if interrupts were acknowledged, which may hide a pending IRQ pin edge.
+static enum rc522c_status poll_completion(
+    struct rc522c_state* s, char* rx, int rx_len, int* rx_drained, char* irq, int* done, int* irq_acked)
+{
+    *done = 0;
+    *irq_acked = 0;
+    s->poll_count++;
+    CHECK_RC522C_STATUS(s, spi_read_byte(s, RC522_REG_COM_IRQ, irq));
+    if (*irq & 0x31) // 0x20 = received data, 0x10 = command terminated, 0x1 = timer counter reached 0
+    {
+        *done = 1;
+        return RC522C_STATUS_SUCCESS;
+    }
 
-    for (int i = 0; i < tx_bytes; ++i)
-        CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_FIFO_DATA, tx[i]));
+    // 0x8 = HiAlert, the FIFO is about to overflow (MFRC522 9.3.1.5). Drain it before the rest of the response
+    // arrives; clearing the IRQ afterwards is safe because HiAlert is set again only when the FIFO refills.
+    if (*irq & 0x8)
+        CHECK_RC522C_STATUS(s, drain_fifo(s, rx, rx_len, rx_drained));
+    // 0x2 = error, reported in detail by the ERROR register once the command completes
+    if (*irq & 0xA)
+    {
+        CHECK_RC522C_STATUS(s, spi_write_byte(s, RC522_REG_COM_IRQ, *irq & 0xA));
+        *irq_acked = 1;
+    }
+    return RC522C_STATUS_SUCCESS;
+}
 
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_CMD, RC522_CMD_TRANSCEIVE));
-    // 0x80 starts the transition, lowest 3 bits = number of bits in the last byte
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_BIT_FRAMING, 0x80 | (tx_bits % 8)));
+// Waits until the transceive command completes or times out, draining long responses from the FIFO on the way.
+// When the IRQ pin is connected, the SPI bus is only touched after an interrupt; otherwise COM_IRQ is polled.
+enum rc522c_status wait_for_completion(struct rc522c_state* s, char* rx, int rx_len, int* rx_drained, char* irq)
+{
+    int use_irq_pin = s->irq_pin >= 0 && !s->irq_broken;
+    // Another interrupt may have been raised while the acknowledged ones were still holding the IRQ line,
+    // in which case there will be no edge to wait for
+    int irq_pending = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;)
+    {
+        if (use_irq_pin && !irq_pending && !s->transport->wait_irq(s, RC522_IRQ_WAIT_TIMEOUT_US))
+        {
+            // The interrupt got lost; the RF timer has long expired, so polling will finish quickly. An IRQ line that
+            // drops one interrupt can't be trusted with the next ones either.
+            use_irq_pin = 0;
+            s->irq_broken = 1;
+            s->stats.irq_lost++;
+        }
 
-    char irq;
-    int i;
-    for (i = 0; i < 2000; ++i)
+        int done;
+        CHECK_RC522C_STATUS(s, poll_completion(s, rx, rx_len, rx_drained, irq, &done, &irq_pending));
+        if (done)
+            return RC522C_STATUS_SUCCESS;
+        // The RF timer ends every command; this only guards against a chip that has stopped updating COM_IRQ.
+        // It's a time limit rather than a number of polls, which a fast SPI clock can use up before the 4.1ms of an
+        // EEPROM write are over.
+        if (elapsed_us(&start) > RC522_IRQ_WAIT_TIMEOUT_US)
+            return RC522C_STATUS_SUCCESS;
+    }
+}
+
+static const char* const stats_cmd_names[RC522C_STATS_CMD_COUNT] = {
+    "REQA", "WUPA", "SDD", "SEL", "GET_VERSION", "READ", "FAST_READ", "WRITE", "PWD_AUTH", "HLTA", "OTHER"};
+
+const char* rc522c_stats_cmd_name(enum rc522c_stats_cmd cmd)
+{
+    return cmd >= 0 && cmd < RC522C_STATS_CMD_COUNT ? stats_cmd_names[cmd] : NULL;
+}
+
+void rc522c_stats_reset(struct rc522c_state* s)
+{
+    memset(&s->stats, 0, sizeof(s->stats));
+}
+
+static enum rc522c_stats_cmd stats_cmd(const char* tx, int tx_bits)
+{
+    unsigned char cmd = tx[0];
+    if (tx_bits == 7)
+        return cmd == NTAG_CMD_REQA ? RC522C_STATS_REQA : cmd == NTAG_CMD_WUPA ? RC522C_STATS_WUPA : RC522C_STATS_OTHER;
+
+    switch (cmd)
     {
-        CHECK_PIGPIO(s, spi_read_byte(s, RC522_REG_COM_IRQ, &irq));
-        if (irq & 0x31) // 0x20 = received data, 0x10 = command terminated, 0x1 = timer counter reached 0
-            break;
+    case NTAG_CMD_CL1_SEL:
+    case NTAG_CMD_CL2_SEL:
+        // The second byte is NVB: 0x70 for SEL_REQ, less for SDD_REQ
+        return tx_bits >= 16 && (unsigned char)tx[1] == NTAG_CMD_SEL_REQ ? RC522C_STATS_SEL : RC522C_STATS_SDD;
+    case NTAG_CMD_GET_VERSION:
+        return RC522C_STATS_GET_VERSION;
+    case NTAG_CMD_READ:
+        return RC522C_STATS_READ;
+    case NTAG_CMD_FAST_READ:
+        return RC522C_STATS_FAST_READ;
+    case NTAG_CMD_WRITE:
+        return RC522C_STATS_WRITE;
+    case NTAG_CMD_PWD_AUTH:
+        return RC522C_STATS_PWD_AUTH;
+    case NTAG_CMD_HLTA:
+        return RC522C_STATS_HLTA;
+    default:
+        return RC522C_STATS_OTHER;
+    }
+}
+
+// Taken when a command is sent, see stats_record
+struct stats_mark
+{
+    struct timespec start;
+    unsigned int spi_xfer_count;
+    unsigned int poll_count;
+};
+
+static void stats_mark(struct rc522c_state* s, struct stats_mark* m)
+{
+    clock_gettime(CLOCK_MONOTONIC, &m->start);
+    m->spi_xfer_count = s->spi_xfer_count;
+    m->poll_count = s->poll_count;
+}
+
+// Accounts a finished transceive. rx and rx_bits are only looked at if status is RC522C_STATUS_SUCCESS.
+static void stats_record(struct rc522c_state* s, const struct stats_mark* m, enum rc522c_stats_cmd cmd,
+    enum rc522c_status status, const char* rx, int rx_bits)
+{
+    long long us = elapsed_us(&m->start);
+    if (us < 0)
+        us = 0;
+
+    struct rc522c_cmd_stats* c = &s->stats.cmds[cmd];
+    c->count++;
+    c->spi_xfers += s->spi_xfer_count - m->spi_xfer_count;
+    c->polls += s->poll_count - m->poll_count;
+    c->total_us += us;
+    if (us > c->max_us)
+        c->max_us = us;
+    int bucket = us > 0 ? 63 - __builtin_clzll(us) : 0;
+    if (bucket >= RC522C_STATS_LATENCY_BUCKETS)
+        bucket = RC522C_STATS_LATENCY_BUCKETS - 1;
+    c->latency_hist[bucket]++;
+
+    switch (status)
+    {
+    case RC522C_STATUS_SUCCESS:
+        if (rx_bits == NTAG_ACKNAK_RX_BITS && (rx[0] & NTAG_ACKNAK_MASK) != NTAG_ACK)
+            c->naks[rx[0] & NTAG_ACKNAK_MASK]++;
+        break;
+    case RC522C_STATUS_ERROR_TAG_MISSING:
+        c->timeouts++;
+        break;
+    case RC522C_STATUS_ERROR_TAG_COLLISION:
+        c->collisions++;
+        break;
+    default:
+        c->errors++;
+        break;
     }
+}
 
-    CHECK_PIGPIO(s, spi_write_byte(s, RC522_REG_BIT_FRAMING, 0)); // clear transmission bits
+// Sends the command and starts the transceive, without waiting for the response. rx_align is the bit position in the
+// first FIFO byte where the first received bit is stored (only used by anticollision, 0 otherwise).
+// crc is a combination of RC522C_CRC_* flags (hw_crc mode only, 0 otherwise).
+static enum rc522c_status transceive_begin(
+    struct rc522c_state* s, const char* tx, int tx_bits, int rx_align, int crc, int timeout_us)
+{
+    int tx_bytes = (tx_bits + 7) / 8; // ceil
+
+    // The whole command setup is sent as a single batch
+    struct spi_batch b;
+    spi_batch_init(&b);
+    set_timeout(s, &b, timeout_us);
+    // Bit 7 = TxCRCEn/RxCRCEn. The registers are only written when the mode changes (e.g. between SDD and SEL_REQ).
+    if (s->crc_mode < 0 || ((s->crc_mode ^ crc) & RC522C_CRC_TX))
+        spi_batch_write(&b, RC522_REG_TX_MODE, (crc & RC522C_CRC_TX) ? 0x80 : 0);
+    if (s->crc_mode < 0 || ((s->crc_mode ^ crc) & RC522C_CRC_RX))
+        spi_batch_write(&b, RC522_REG_RX_MODE, (crc & RC522C_CRC_RX) ? 0x80 : 0);
+    s->crc_mode = crc;
+    spi_batch_write(&b, RC522_REG_COM_IRQ, 0x7F);          // clear interrupt request
+    spi_batch_write(&b, RC522_REG_COM_IEN, RC522_COM_IEN); // route completion interrupts to the IRQ pin
+    spi_batch_write(&b, RC522_REG_FIFO_LEVEL, 0x80);       // clear FIFO buffer
+    spi_batch_write(&b, RC522_REG_CMD, RC522_CMD_IDLE);    // don't execute any commands yet
+    spi_batch_write_fifo(&b, tx, tx_bytes);
+    spi_batch_write(&b, RC522_REG_CMD, RC522_CMD_TRANSCEIVE);
+    // 0x80 starts the transition, bits 4-6 = RxAlign, lowest 3 bits = number of bits in the last byte
+    spi_batch_write(&b, RC522_REG_BIT_FRAMING, 0x80 | (rx_align << 4) | (tx_bits % 8));
+
+    // Edges from the previous command have already been handled
+    if (s->irq_pin >= 0 && !s->irq_broken)
+        s->transport->clear_irq(s);
+
+    return spi_batch_flush(s, &b);
+}
 
-    char error;
-    CHECK_PIGPIO(s, spi_read_byte(s, RC522_REG_ERROR, &error));
+// Reads out the rest of the response once the command has completed; irq is the final value of COM_IRQ
+static enum rc522c_status transceive_finish(
+    struct rc522c_state* s, char irq, char* rx, int rx_len, int rx_drained, int* rx_bits)
+{
+    struct spi_batch b;
+    spi_batch_init(&b);
+    char error, rx_bytes, ctrl;
+    spi_batch_write(&b, RC522_REG_BIT_FRAMING, 0); // clear transmission bits
+    spi_batch_read(&b, RC522_REG_ERROR, &error);
+    spi_batch_read(&b, RC522_REG_FIFO_LEVEL, &rx_bytes);
+    spi_batch_read(&b, RC522_REG_CTRL, &ctrl);
+    CHECK_RC522C_STATUS(s, spi_batch_flush(s, &b));
+
+    // 0x04 = CRCErr, only meaningful when the chip checks the CRC itself (RxCRCEn); see below
+    int crc_error = (error & 0x04) != 0;
     error &= 0xDB; // ignore crc errors and reserved
-    if (error)
+    // 0x08 = CollErr: several tags answered at once. The response is still read out (anticollision needs the bits
+    // received before the collision), the error is returned afterwards.
+    int collision = error == 0x08;
+    if (error && !collision)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_DEV_CMD_FAILED, error);
 
     // Check for timer interrupt and interpret it as timeout, i.e. the tag did not answer
     if (irq & 0x1)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, error);
 
-    char rx_bytes;
-    CHECK_PIGPIO(s, spi_read_byte(s, RC522_REG_FIFO_LEVEL, &rx_bytes));
+    rx_bytes &= 0x7F;
 
     // I think this shouldn't happen, but sometimes it does. Possibly some unrelated interrupt going off?
-    if (rx_bytes == 0)
+    if (rx_drained + rx_bytes == 0)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, error);
 
-    char ctrl;
-    CHECK_PIGPIO(s, spi_read_byte(s, RC522_REG_CTRL, &ctrl));
+    if (rx_drained + rx_bytes > rx_len)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
 
-    *rx_bits = rx_bytes * 8;
+    *rx_bits = (rx_drained + rx_bytes) * 8;
     char valid_bits_in_last_rx_byte = ctrl & 0x7;
     if (valid_bits_in_last_rx_byte != 0)
         *rx_bits -= 8 - valid_bits_in_last_rx_byte;
 
-    if (rx_bytes == 0 && *rx_bits > 0)
-        rx_bytes = 1;
+    // ACK/NAK has no CRC_A (NTAG21x section 9.3), so RxCRCEn flags it as a CRC error
+    if (crc_error && (s->crc_mode & RC522C_CRC_RX) && *rx_bits != NTAG_ACKNAK_RX_BITS)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+
+    char coll = 0;
+    if (rx_bytes > 0 || collision)
+    {
+        spi_batch_read_fifo(&b, &rx[rx_drained], rx_bytes);
+        if (collision)
+            spi_batch_read(&b, RC522_REG_COLL, &coll);
+        CHECK_RC522C_STATUS(s, spi_batch_flush(s, &b));
+    }
 
-    for (int i = 0; i < rx_bytes; ++i)
-        CHECK_PIGPIO(s, spi_read_byte(s, RC522_REG_FIFO_DATA, &rx[i]));
+    if (collision)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_COLLISION, (unsigned char)coll);
 
     return RC522C_STATUS_SUCCESS;
 }
 
-enum rc522c_status rc522c_ntag_select(struct rc522c_state* s)
+// rx_len is the capacity of rx. Responses longer than RC522_FIFO_SIZE are drained from the FIFO while
+// they are still being received, so rx_len may exceed the FIFO size.
+// timeout_us is the time the tag has to start responding, see RC522C_TIMEOUT_*
+// crc is a combination of RC522C_CRC_* flags (hw_crc mode only, 0 otherwise); most commands go through ntag_transceive
+// on success, returns number of _bits_ read to rx
+enum rc522c_status rc522c_transceive(
+    struct rc522c_state* s, const char* tx, int tx_bits, char* rx, int rx_len, int* rx_bits, int timeout_us, int crc)
 {
-    char rx[64];
+    struct stats_mark mark;
+    stats_mark(s, &mark);
+
+    // Number of bytes already drained from the FIFO while the response was being received
+    int rx_drained = 0;
+    char irq;
+
+    enum rc522c_status status = transceive_begin(s, tx, tx_bits, 0, crc, timeout_us);
+    if (status == RC522C_STATUS_SUCCESS)
+        status = wait_for_completion(s, rx, rx_len, &rx_drained, &irq);
+    if (status == RC522C_STATUS_SUCCESS)
+        status = transceive_finish(s, irq, rx, rx_len, rx_drained, rx_bits);
+
+    stats_record(s, &mark, stats_cmd(tx, tx_bits), status, rx, status == RC522C_STATUS_SUCCESS ? *rx_bits : 0);
+    return status;
+}
+
+// Sends a command frame with CRC_A appended (NFC Digital Protocol, section 4.4). If rx_crc is 1, the response carries
+// CRC_A too: it's checked and stripped, so *rx_bits only counts the payload. ACK/NAK (4 bits) has no CRC and is
+// returned as is. In hw_crc mode the chip does all of this, saving two bytes of FIFO traffic each way.
+static enum rc522c_status ntag_transceive(
+    struct rc522c_state* s, const char* tx, int tx_len, char* rx, int rx_len, int* rx_bits, int timeout_us, int rx_crc)
+{
+    if (s->hw_crc)
+        return rc522c_transceive(
+            s, tx, tx_len * 8, rx, rx_len, rx_bits, timeout_us, RC522C_CRC_TX | (rx_crc ? RC522C_CRC_RX : 0));
+
+    char frame[RC522_FIFO_SIZE];
+    memcpy(frame, tx, tx_len);
+    compute_crc(frame, tx_len, &frame[tx_len]);
+    CHECK_RC522C_STATUS(s, rc522c_transceive(s, frame, (tx_len + 2) * 8, rx, rx_len, rx_bits, timeout_us, 0));
+    if (!rx_crc || *rx_bits == NTAG_ACKNAK_RX_BITS)
+        return RC522C_STATUS_SUCCESS;
+
+    int len = *rx_bits / 8 - 2;
+    char crc[2] = {0};
+    if (*rx_bits % 8 == 0 && len >= 1)
+        compute_crc(rx, len, crc);
+    if (*rx_bits % 8 != 0 || len < 1 || crc[0] != rx[len] || crc[1] != rx[len + 1])
+    {
+        // The transceive itself went through, so it hasn't been counted as a failure yet
+        s->stats.cmds[stats_cmd(tx, tx_len * 8)].errors++;
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+    }
+    *rx_bits -= 16;
+    return RC522C_STATUS_SUCCESS;
+}
+
+int rc522c_ntag_page_count(enum rc522c_tag_kind kind)
+{
+    switch (kind)
+    {
+    case RC522C_TAG_KIND_213:
+        return 45;
+    case RC522C_TAG_KIND_215:
+        return 135;
+    case RC522C_TAG_KIND_216:
+        return 231;
+    default:
+        return 0;
+    }
+}
+
+int rc522c_ntag_config_page(enum rc522c_tag_kind kind)
+{
+    return rc522c_ntag_page_count(kind) - 4;
+}
+
+// Whether the contents of a page can be kept in the shadow after the page has been read (or written, if written is 1)
+static int shadow_cacheable(struct rc522c_state* s, int page, int written)
+{
+    int config_page = rc522c_ntag_config_page(s->tag_kind);
+    // NTAG21x section 8.5.7: PWD and PACK always read back as zeros
+    if (page == config_page + 2 || page == config_page + 3)
+        return 0;
+    // NTAG21x sections 8.5.2, 8.5.6 and 8.5.3: writing the static lock bytes, the capability container or the
+    // dynamic lock bytes ORs the data into the current contents instead of replacing them
+    if (written && (page == 2 || page == 3 || page == config_page - 1))
+        return 0;
+    return 1;
+}
+
+// Stores pages read from the tag. READ wraps around to page 0 past the end of the memory (NTAG21x section 10.2)
+static void shadow_store(struct rc522c_state* s, int page, const char* data, int n_pages)
+{
+    int page_count = rc522c_ntag_page_count(s->tag_kind);
+    if (!s->shadow_enabled || page_count == 0)
+        return;
+    for (int i = 0; i < n_pages; ++i)
+    {
+        int p = (page + i) % page_count;
+        if (shadow_cacheable(s, p, 0))
+        {
+            memcpy(&s->shadow[p * 4], &data[i * 4], 4);
+            s->shadow_valid[p] = 1;
+        }
+    }
+}
+
+void rc522c_ntag_set_shadow(struct rc522c_state* s, int enabled)
+{
+    s->shadow_enabled = enabled;
+    memset(s->shadow_valid, 0, sizeof(s->shadow_valid));
+}
+
+// Selects cascade level cl (0 = CL1, 1 = CL2). nfcid_part is the SDD_RES payload for that level: four bytes of
+// the NFCID (for CL1, the cascade tag and NFCID_0..2) followed by BCC.
+static enum rc522c_status ntag_sel_req(struct rc522c_state* s, int cl, const char* nfcid_part)
+{
+    char rx[RC522_FIFO_SIZE];
+    int rx_bits;
+
+    // Per NFC Digital Protocol:
+    // The payload is the NFCID part we've received in SDD_RES.
+    // Since BCC is calculated the same as in SDD_RES, we can resend it too.
+    const char cl_selectors[2] = {NTAG_CMD_CL1_SEL, NTAG_CMD_CL2_SEL};
+    char tx_sel[7] = {cl_selectors[cl], NTAG_CMD_SEL_REQ, nfcid_part[0], nfcid_part[1], nfcid_part[2],
+        nfcid_part[3], nfcid_part[4]};
+    // Section 4.5: EoD _is_ present for SEL_REQ
+    // Section 4.4: EoD is appended to payload and consists of a two-byte checksum (CRC_A) computed from the payload
+    CHECK_RC522C_STATUS(
+        s, ntag_transceive(s, tx_sel, sizeof(tx_sel), rx, sizeof(rx), &rx_bits, RC522C_TIMEOUT_ANTICOLL_US, 1));
+    // We expect SEL_RES in response (followed by CRC_A)
+    if (rx_bits != 8)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+
+    if (cl == 0)
+    {
+        // This shouldn't really happen... Bit 3 (cascade bit) is set to 1 if we need to proceed to CL2, which we do
+        if ((rx[0] & 0x04) == 0)
+            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+    }
+    else
+    {
+        // This can happen with tags that have 3 cascade levels (not supported).
+        // NTAG21x is expected to have cascade bit = 0 in SEL_RES for CL2.
+        if ((rx[0] & 0x04) != 0)
+            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+    }
+
+    return RC522C_STATUS_SUCCESS;
+}
+
+// NTAG21x section 10.1: GET_VERSION returns 8 bytes of product info. It's accepted in both ACTIVE and AUTHENTICATED
+// states and doesn't change the state.
+static enum rc522c_status ntag_get_version(struct rc522c_state* s, char* out, int timeout_us)
+{
+    char rx[RC522_FIFO_SIZE];
     int rx_bits;
 
+    char tx_get_version[1] = {NTAG_CMD_GET_VERSION};
+    CHECK_RC522C_STATUS(
+        s, ntag_transceive(s, tx_get_version, sizeof(tx_get_version), rx, sizeof(rx), &rx_bits, timeout_us, 1));
+    // First, check for a NAK response (4 bits)
+    char acknak = rx[0] & NTAG_ACKNAK_MASK;
+    if (rx_bits == NTAG_ACKNAK_RX_BITS && acknak != NTAG_ACK)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_NAK, acknak);
+    // If the response is not a NAK, we expect 8 bytes of product info
+    if (rx_bits != 8 * 8)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+
+    memcpy(out, rx, 8);
+    return RC522C_STATUS_SUCCESS;
+}
+
+// Forgets the current tag before a new one is selected
+static void ntag_deselect(struct rc522c_state* s)
+{
     s->tag_selected = 0;
+    s->tag_known = 0;
+    // The shadow belongs to the previously selected tag, which may have been modified in the meantime
+    memset(s->shadow_valid, 0, sizeof(s->shadow_valid));
+}
 
-    char tx_reqa[] = {NTAG_CMD_REQA};
-    CHECK_RC522C_STATUS(s, rc522c_transceive(s, tx_reqa, 7 /* REQA is a 7 bit command */, rx, &rx_bits));
+// Sends REQA or WUPA (NFC Digital Protocol, section 4.6). Every tag in the field that accepts the command answers with
+// ATQA. Tags with different ATQAs collide, which is fine: anticollision sorts them out.
+static enum rc522c_status ntag_request(struct rc522c_state* s, char cmd)
+{
+    char rx[RC522_FIFO_SIZE];
+    int rx_bits;
+
+    enum rc522c_status status = rc522c_transceive(
+        s, &cmd, 7 /* REQA and WUPA are 7 bit commands */, rx, sizeof(rx), &rx_bits, RC522C_TIMEOUT_ANTICOLL_US, 0);
+    if (status != RC522C_STATUS_ERROR_TAG_COLLISION)
+        CHECK_RC522C_STATUS(s, status);
     if (rx_bits != 16)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+    return RC522C_STATUS_SUCCESS;
+}
 
-    // NTAG21x has a 7-bit NFCID and needs to go through two cascade levels (CL1, CL2) before we can work with it
+// Bit oriented anticollision for cascade level cl (NFC Digital Protocol, section 4.7; ISO/IEC 14443-3, 6.5.3).
+// SDD_REQ carries the UID bits known so far, and only the tags that match them answer with the rest. When the
+// answers collide, the bits up to the collision are taken as known, the colliding bit is set to 1 and the request
+// is repeated, until a single tag is left. uid receives its SDD_RES: four bytes of the NFCID and BCC.
+static enum rc522c_status ntag_sdd(struct rc522c_state* s, int cl, char* uid)
+{
     const char cl_selectors[2] = {NTAG_CMD_CL1_SEL, NTAG_CMD_CL2_SEL};
+    memset(uid, 0, 5);
+
+    // Every round learns at least one more bit of the 32
+    int known_bits = 0;
+    for (int round = 0; round <= 32; ++round)
+    {
+        // NVB: number of complete bytes sent (including SEL and NVB itself) in the upper nibble, extra bits in the
+        // lower one. Section 4.5: EoD _is not_ present for SDD_REQ.
+        int first = known_bits / 8, align = known_bits % 8;
+        char tx[7] = {cl_selectors[cl], (char)(((2 + first) << 4) | align)};
+        memcpy(&tx[2], uid, (known_bits + 7) / 8);
+
+        // The tags continue the split byte where the request ends, so the reception is aligned the same way
+        char rx[RC522_FIFO_SIZE];
+        int rx_bits = 0;
+        int rx_drained = 0;
+        char irq;
+        struct stats_mark mark;
+        stats_mark(s, &mark);
+        enum rc522c_status status = transceive_begin(s, tx, 16 + known_bits, align, 0, RC522C_TIMEOUT_ANTICOLL_US);
+        if (status == RC522C_STATUS_SUCCESS)
+            status = wait_for_completion(s, rx, sizeof(rx), &rx_drained, &irq);
+        if (status == RC522C_STATUS_SUCCESS)
+            status = transceive_finish(s, irq, rx, sizeof(rx), rx_drained, &rx_bits);
+        stats_record(s, &mark, RC522C_STATS_SDD, status, rx, rx_bits);
+        if (round > 0)
+            s->stats.cmds[RC522C_STATS_SDD].retries++;
+
+        if (status != RC522C_STATUS_SUCCESS && status != RC522C_STATUS_ERROR_TAG_COLLISION)
+            return status;
+        // The rest of SDD_RES: the response ends with BCC, so it's always a whole number of bytes
+        if (rx_bits != (5 - first) * 8)
+            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+        char known_mask = (char)((1 << align) - 1);
+        uid[first] = (uid[first] & known_mask) | (rx[0] & ~known_mask);
+        memcpy(&uid[first + 1], &rx[1], 4 - first);
+
+        if (status == RC522C_STATUS_SUCCESS)
+        {
+            char bcc_check = uid[0] ^ uid[1] ^ uid[2] ^ uid[3];
+            if (bcc_check != uid[4])
+                RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+            return RC522C_STATUS_SUCCESS;
+        }
+
+        // MFRC522 9.3.1.15: CollPos is the 1-based position of the first collision in the received frame, counted
+        // from the first bit of the first FIFO byte (32 reads as 0). 0x20 = CollPosNotValid.
+        int coll = s->error_code;
+        if (coll & 0x20)
+            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, coll);
+        int coll_bit = first * 8 + ((coll & 0x1F) ? (coll & 0x1F) : 32) - 1;
+        // The known bits are the same for all tags that answered, and BCC can't collide unless the NFCID did
+        if (coll_bit < known_bits || coll_bit >= 32)
+            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, coll);
+
+        // Bits after the collision were cleared by the chip (ValuesAfterColl = 0)
+        uid[coll_bit / 8] |= 1 << (coll_bit % 8);
+        known_bits = coll_bit + 1;
+    }
+    RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+}
+
+// Finds out the type of the tag that has just been activated by issuing the GET_VERSION command
+static enum rc522c_status ntag_identify(struct rc522c_state* s)
+{
+    char version[8];
+    CHECK_RC522C_STATUS(s, ntag_get_version(s, version, RC522C_TIMEOUT_READ_US));
+
+    switch (version[NTAG_VERSION_STORAGE_SIZE_BYTE])
+    {
+    case NTAG_VERSION_STORAGE_SIZE_213:
+        s->tag_kind = RC522C_TAG_KIND_213;
+        break;
+    case NTAG_VERSION_STORAGE_SIZE_215:
+        s->tag_kind = RC522C_TAG_KIND_215;
+        break;
+    case NTAG_VERSION_STORAGE_SIZE_216:
+        s->tag_kind = RC522C_TAG_KIND_216;
+        break;
+    default:
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+    }
+
+    s->tag_selected = 1;
+    s->tag_known = 1;
+
+    return RC522C_STATUS_SUCCESS;
+}
+
+// Runs anticollision and selection for the tags that have answered REQA with ATQA, then finds out the type of the
+// selected one. If there are several tags in the field, the one with the highest NFCID bit at each collision wins.
+static enum rc522c_status ntag_select_cascade(struct rc522c_state* s)
+{
+    // NTAG21x has a 7-bit NFCID and needs to go through two cascade levels (CL1, CL2) before we can work with it
     for (int cl = 0; cl < 2; cl++)
     {
-        // Per NFC Digital Protocol:
-        // Section 4.5: EoD _is not_ present for SDD_REQ. We only need to send two bytes, as described in section 4.7
-        // (SDD_REQ)
-        char tx_sdd[] = {cl_selectors[cl], NTAG_CMD_SDD_REQ};
-        CHECK_RC522C_STATUS(s, rc522c_transceive(s, tx_sdd, sizeof(tx_sdd) * 8, rx, &rx_bits));
-        // We expect 5 bytes in response:
         // CL1: cascade tag (0x88), NFCID_0, NFCID_1, NFCID_2, BCC (xor of first four bytes)
         // CL2: NFCID_3, NFCID_4, NFCID_5, NFCID_6, BCC
-        if (rx_bits != 5 * 8)
-            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
-        char bcc_check = rx[0] ^ rx[1] ^ rx[2] ^ rx[3];
-        if (bcc_check != rx[4])
-            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+        char uid[5];
+        CHECK_RC522C_STATUS(s, ntag_sdd(s, cl, uid));
 
         if (cl == 0)
         {
             // If we haven't received the cascade tag in CL1 SDD_RES, it means the tag is not an NTAG21x --
             // probably a MIFARE Classic (4-bit NFCID)
-            if (rx[0] != NFC_CASCADE_TAG)
+            if ((unsigned char)uid[0] != NFC_CASCADE_TAG)
                 RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
-            s->tag_nfcid[0] = rx[1];
-            s->tag_nfcid[1] = rx[2];
-            s->tag_nfcid[2] = rx[3];
+            memcpy(&s->tag_nfcid[0], &uid[1], 3);
         }
         else
         {
-            s->tag_nfcid[3] = rx[0];
-            s->tag_nfcid[4] = rx[1];
-            s->tag_nfcid[5] = rx[2];
-            s->tag_nfcid[6] = rx[3];
+            memcpy(&s->tag_nfcid[3], &uid[0], 4);
         }
 
-        // Per NFC Digital Protocol:
-        // The payload is the NFCID part we've received in SDD_RES.
-        // Since BCC is calculated the same as in SDD_RES, we can resend it too.
-        char tx_sel[9] = {cl_selectors[cl], NTAG_CMD_SEL_REQ, rx[0], rx[1], rx[2], rx[3], rx[4], 0};
-        // Section 4.5: EoD _is_ present for SEL_REQ
-        // Section 4.4: EoD is appended to payload and consists of a two-byte checksum (CRC_A) computed from the payload
-        compute_crc(&s->crc, tx_sel, 7, &tx_sel[7]);
-
-        CHECK_RC522C_STATUS(s, rc522c_transceive(s, tx_sel, sizeof(tx_sel) * 8, rx, &rx_bits));
-        // We expect 3 bytes in response: SEL_RES and CRC_A[1,2]
-        if (rx_bits != 24)
-            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
-        char sel_crc[2] = {0};
-        compute_crc(&s->crc, rx, 1, sel_crc);
-        if (sel_crc[0] != rx[1] || sel_crc[1] != rx[2])
-            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+        CHECK_RC522C_STATUS(s, ntag_sel_req(s, cl, uid));
+    }
 
-        if (cl == 0)
+    return ntag_identify(s);
+}
+
+enum rc522c_status rc522c_ntag_select(struct rc522c_state* s)
+{
+    ntag_deselect(s);
+    CHECK_RC522C_STATUS(s, ntag_request(s, NTAG_CMD_REQA));
+    return ntag_select_cascade(s);
+}
+
+int rc522c_is_tag_error(enum rc522c_status status)
+{
+    return status == RC522C_STATUS_ERROR_TAG_MISSING || status == RC522C_STATUS_ERROR_TAG_UNSUPPORTED ||
+           status == RC522C_STATUS_ERROR_TAG_NAK || status == RC522C_STATUS_ERROR_TAG_COLLISION;
+}
+
+enum rc522c_status rc522c_set_antenna(struct rc522c_state* s, int on)
+{
+    if (!on)
+        s->tag_selected = 0;
+    return spi_write_byte(s, RC522_REG_TX_CTRL, on ? s->tx_ctrl : (char)(s->tx_ctrl & ~0x03));
+}
+
+// Sends a single REQA with a short timeout. Sets *out_answered if any tag answered, even if the answers collided.
+static enum rc522c_status ntag_probe(struct rc522c_state* s, int* out_answered)
+{
+    char cmd = NTAG_CMD_REQA;
+    char rx[RC522_FIFO_SIZE];
+    int rx_bits;
+
+    enum rc522c_status status = rc522c_transceive(
+        s, &cmd, 7 /* REQA is a 7 bit command */, rx, sizeof(rx), &rx_bits, RC522C_TIMEOUT_PROBE_US, 0);
+    *out_answered = status == RC522C_STATUS_SUCCESS || status == RC522C_STATUS_ERROR_TAG_COLLISION;
+    // A garbled answer from a tag that's just entering the field is left to the next probe
+    return rc522c_is_tag_error(status) ? RC522C_STATUS_SUCCESS : status;
+}
+
+enum rc522c_status rc522c_ntag_wait_for_tag(struct rc522c_state* s, int timeout_us, int interval_us)
+{
+    ntag_deselect(s);
+
+    // Switching the field off only pays off if it stays off for longer than the power-up time it costs the tags
+    int duty_cycle = interval_us > RC522C_FIELD_GUARD_US;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    enum rc522c_status status = RC522C_STATUS_ERROR_TAG_MISSING;
+    for (;;)
+    {
+        if (duty_cycle)
         {
-            // This shouldn't really happen... Bit 3 (cascade bit) is set to 1 if we need to proceed to CL2, which we do
-            if ((rx[0] & 0x04) == 0)
-                RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+            CHECK_RC522C_STATUS(s, rc522c_set_antenna(s, 1));
+            rc522c_sleep_us(RC522C_FIELD_GUARD_US);
         }
-        else
+
+        int answered;
+        status = ntag_probe(s, &answered);
+        if (status != RC522C_STATUS_SUCCESS)
+            break;
+        if (answered)
         {
-            // This can happen with tags that have 3 cascade levels (not supported).
-            // NTAG21x is expected to have cascade bit = 0 in SEL_RES for CL2.
-            if ((rx[0] & 0x04) != 0)
-                RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+            // The tags that answered are in READY now, so the REQA sent by rc522c_ntag_select isn't needed.
+            // A tag that's only halfway into the field may drop out during anticollision; keep waiting then.
+            status = ntag_select_cascade(s);
+            if (status == RC522C_STATUS_SUCCESS || !rc522c_is_tag_error(status))
+                break;
         }
+        status = RC522C_STATUS_ERROR_TAG_MISSING;
+
+        // Once the next probe would be due after the timeout, sleep through the rest of it and return
+        long long left = timeout_us - elapsed_us(&start);
+        if (timeout_us >= 0 && left <= 0)
+            break;
+        if (duty_cycle)
+            CHECK_RC522C_STATUS(s, rc522c_set_antenna(s, 0));
+        int sleep_us = timeout_us >= 0 && left < interval_us ? (int)left : interval_us;
+        if (sleep_us > 0)
+            rc522c_sleep_us(sleep_us);
+        if (timeout_us >= 0 && left <= interval_us)
+            break;
     }
 
-    // Find the tag type by issuing the GET_VERSION command (NTAG21x section 10.1)
+    // Leave the field on, as rc522c_init does
+    if (duty_cycle)
+        CHECK_RC522C_STATUS(s, rc522c_set_antenna(s, 1));
+    return status;
+}
+
+// Wakes up the tags in the field (including halted ones) and selects the one with the given NFCID. SDD is only needed
+// to learn the NFCID, which we already know: both SDD_RES payloads are rebuilt from it. Other tags don't answer the
+// SEL_REQs and return to IDLE (or HALT) on the next command.
+static enum rc522c_status ntag_wakeup_select(struct rc522c_state* s, const char* id)
+{
+    // WUPA, unlike REQA, also wakes up tags in the HALT state (NFC Digital Protocol, section 4.7)
+    CHECK_RC522C_STATUS(s, ntag_request(s, NTAG_CMD_WUPA));
+
+    char cl1[5] = {(char)NFC_CASCADE_TAG, id[0], id[1], id[2], (char)NFC_CASCADE_TAG ^ id[0] ^ id[1] ^ id[2]};
+    char cl2[5] = {id[3], id[4], id[5], id[6], id[3] ^ id[4] ^ id[5] ^ id[6]};
+    CHECK_RC522C_STATUS(s, ntag_sel_req(s, 0, cl1));
+    CHECK_RC522C_STATUS(s, ntag_sel_req(s, 1, cl2));
+    return RC522C_STATUS_SUCCESS;
+}
+
+// NFC Digital Protocol, section 4.9: HLTA puts the selected tag to sleep. It's acknowledged by not answering.
+enum rc522c_status rc522c_ntag_halt(struct rc522c_state* s)
+{
+    char rx[RC522_FIFO_SIZE];
+    int rx_bits;
+
+    char tx_hlta[2] = {NTAG_CMD_HLTA, 0};
+    enum rc522c_status status =
+        ntag_transceive(s, tx_hlta, sizeof(tx_hlta), rx, sizeof(rx), &rx_bits, RC522C_TIMEOUT_ANTICOLL_US, 0);
+    s->tag_selected = 0;
+    if (status == RC522C_STATUS_ERROR_TAG_MISSING)
+        return RC522C_STATUS_SUCCESS;
+    if (status == RC522C_STATUS_SUCCESS)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+    return status;
+}
+
+enum rc522c_status rc522c_ntag_select_multi(struct rc522c_state** readers, int n, int* out_selected, int* out_failed)
+{
+    struct
     {
-        char tx_get_version[3] = {NTAG_CMD_GET_VERSION, 0};
-        compute_crc(&s->crc, tx_get_version, 1, &tx_get_version[1]);
-        CHECK_RC522C_STATUS(s, rc522c_transceive(s, tx_get_version, sizeof(tx_get_version) * 8, rx, &rx_bits));
-        // First, check for a NAK response (4 bits)
-        char acknak = rx[0] & NTAG_ACKNAK_MASK;
-        if (rx_bits == NTAG_ACKNAK_RX_BITS && acknak != NTAG_ACK)
-            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_NAK, acknak);
-        // If the response is not a NAK, we expect 10 bytes (8 bytes of product info + CRC)
-        if (rx_bits != 10 * 8)
-            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
-        char crc[2];
-        compute_crc(&s->crc, rx, 8, crc);
-        if (crc[0] != rx[8] || crc[1] != rx[9])
-            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+        char rx[RC522_FIFO_SIZE];
+        int rx_drained;
+        char irq;
+        int done;
+        struct stats_mark mark;
+    } probe[RC522C_MULTI_MAX_READERS];
+
+    *out_failed = -1;
+    if (n > RC522C_MULTI_MAX_READERS)
+    {
+        *out_failed = 0;
+        RETURN_RC522C_ERROR(readers[0], RC522C_STATUS_ERROR_SYSTEM, EINVAL);
+    }
 
-        switch (rx[NTAG_VERSION_STORAGE_SIZE_BYTE])
+    // Send REQA on all readers back to back, then poll them in turn: each reader's RF wait overlaps
+    // the SPI traffic of the others
+    char tx_reqa[] = {NTAG_CMD_REQA};
+    for (int i = 0; i < n; ++i)
+    {
+        out_selected[i] = 0;
+        probe[i].rx_drained = 0;
+        probe[i].done = 0;
+        ntag_deselect(readers[i]);
+        stats_mark(readers[i], &probe[i].mark);
+        enum rc522c_status status = transceive_begin(readers[i], tx_reqa, 7, 0, 0, RC522C_TIMEOUT_ANTICOLL_US);
+        if (status != RC522C_STATUS_SUCCESS)
         {
-        case NTAG_VERSION_STORAGE_SIZE_213:
-            s->tag_kind = RC522C_TAG_KIND_213;
-            break;
-        case NTAG_VERSION_STORAGE_SIZE_215:
-            s->tag_kind = RC522C_TAG_KIND_215;
-            break;
-        case NTAG_VERSION_STORAGE_SIZE_216:
-            s->tag_kind = RC522C_TAG_KIND_216;
-            break;
-        default:
-            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+            *out_failed = i;
+            return status;
+        }
+    }
+
+    int remaining = n;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // The same safety limit as in wait_for_completion: the RF timer should have ended every REQA long before
+    while (remaining > 0 && elapsed_us(&start) <= RC522_IRQ_WAIT_TIMEOUT_US)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            if (probe[i].done)
+                continue;
+            int irq_acked;
+            enum rc522c_status status = poll_completion(readers[i], probe[i].rx, sizeof(probe[i].rx),
+                &probe[i].rx_drained, &probe[i].irq, &probe[i].done, &irq_acked);
+            if (status != RC522C_STATUS_SUCCESS)
+            {
+                *out_failed = i;
+                return status;
+            }
+            if (probe[i].done)
+                remaining--;
         }
     }
 
+    // Readers that got ATQA finish the selection one after another
+    for (int i = 0; i < n; ++i)
+    {
+        if (!probe[i].done)
+        {
+            // A reader that never completed is stopped, so that its transceive doesn't run into the next command
+            struct spi_batch b;
+            spi_batch_init(&b);
+            spi_batch_write(&b, RC522_REG_BIT_FRAMING, 0);
+            spi_batch_write(&b, RC522_REG_CMD, RC522_CMD_IDLE);
+            spi_batch_write(&b, RC522_REG_FIFO_LEVEL, 0x80); // FlushBuffer
+            enum rc522c_status status = spi_batch_flush(readers[i], &b);
+            stats_record(readers[i], &probe[i].mark, RC522C_STATS_REQA, RC522C_STATUS_ERROR_TAG_MISSING, NULL, 0);
+            if (status != RC522C_STATUS_SUCCESS)
+            {
+                *out_failed = i;
+                return status;
+            }
+            continue;
+        }
+        int rx_bits = 0;
+        enum rc522c_status status = transceive_finish(
+            readers[i], probe[i].irq, probe[i].rx, sizeof(probe[i].rx), probe[i].rx_drained, &rx_bits);
+        stats_record(readers[i], &probe[i].mark, RC522C_STATS_REQA, status, probe[i].rx, rx_bits);
+        // Collided ATQAs mean there are several tags, see ntag_request
+        if (status == RC522C_STATUS_SUCCESS || status == RC522C_STATUS_ERROR_TAG_COLLISION)
+            status = rx_bits == 16 ? ntag_select_cascade(readers[i]) : RC522C_STATUS_ERROR_TAG_UNSUPPORTED;
+
+        if (status == RC522C_STATUS_SUCCESS)
+        {
+            out_selected[i] = 1;
+        }
+        else if (!rc522c_is_tag_error(status))
+        {
+            *out_failed = i;
+            return status;
+        }
+    }
+
+    return RC522C_STATUS_SUCCESS;
+}
+
+enum rc522c_status rc522c_ntag_reselect(struct rc522c_state* s)
+{
+    if (!s->tag_known)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, 0);
+
+    s->tag_selected = 0;
+    memset(s->shadow_valid, 0, sizeof(s->shadow_valid));
+
+    // A different tag in the field won't answer the SEL_REQ
+    CHECK_RC522C_STATUS(s, ntag_wakeup_select(s, s->tag_nfcid));
+
+    // tag_kind is still valid: a tag with the same NFCID is the same tag
     s->tag_selected = 1;
 
     return RC522C_STATUS_SUCCESS;
 }
 
+enum rc522c_status rc522c_ntag_select_nfcid(struct rc522c_state* s, const char* nfcid)
+{
+    ntag_deselect(s);
+    CHECK_RC522C_STATUS(s, ntag_wakeup_select(s, nfcid));
+    memcpy(s->tag_nfcid, nfcid, NTAG_NFCID_LEN);
+    return ntag_identify(s);
+}
+
+enum rc522c_status rc522c_ntag_inventory(
+    struct rc522c_state* s, struct rc522c_ntag_info* out, int max_tags, int* out_count)
+{
+    *out_count = 0;
+    ntag_deselect(s);
+
+    // Every round selects one tag and halts it, so that it stays silent from then on: the next REQA is only answered
+    // by the tags that haven't been seen yet. A tag that can't be selected is halted too if it got as far as ACTIVE;
+    // the round limit ends the loop if one keeps answering anyway.
+    for (int round = 0; round < 2 * max_tags + 2 && *out_count < max_tags; ++round)
+    {
+        enum rc522c_status status = ntag_request(s, NTAG_CMD_REQA);
+        if (status == RC522C_STATUS_ERROR_TAG_MISSING)
+            break;
+        if (status == RC522C_STATUS_SUCCESS)
+            status = ntag_select_cascade(s);
+
+        if (status == RC522C_STATUS_SUCCESS)
+        {
+            memcpy(out[*out_count].nfcid, s->tag_nfcid, NTAG_NFCID_LEN);
+            out[*out_count].kind = s->tag_kind;
+            (*out_count)++;
+        }
+        else if (!rc522c_is_tag_error(status))
+        {
+            return status;
+        }
+
+        status = rc522c_ntag_halt(s);
+        if (!rc522c_is_tag_error(status))
+            CHECK_RC522C_STATUS(s, status);
+    }
+
+    ntag_deselect(s);
+    return RC522C_STATUS_SUCCESS;
+}
+
+enum rc522c_status rc522c_ntag_present(struct rc522c_state* s)
+{
+    if (!s->tag_selected)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, 0);
+
+    // GET_VERSION has the shortest response (10 bytes vs. 18 for READ) among the commands that always succeed
+    // without changing the tag state. The tag answers within the frame delay time, so a short timeout is enough.
+    char version[8];
+    enum rc522c_status status = ntag_get_version(s, version, RC522C_TIMEOUT_ANTICOLL_US);
+    if (status != RC522C_STATUS_SUCCESS)
+        s->tag_selected = 0;
+    return status;
+}
+
 enum rc522c_status rc522c_ntag_read(struct rc522c_state* s, char start_page, char* out)
 {
-    char rx[64];
+    char rx[RC522_FIFO_SIZE];
     int rx_bits;
 
     if (!s->tag_selected)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, 0);
 
-    char tx_read[4] = {NTAG_CMD_READ, start_page, 0};
-    compute_crc(&s->crc, tx_read, 2, &tx_read[2]);
-    CHECK_RC522C_STATUS(s, rc522c_transceive(s, tx_read, sizeof(tx_read) * 8, rx, &rx_bits));
+    char tx_read[2] = {NTAG_CMD_READ, start_page};
+    CHECK_RC522C_STATUS(
+        s, ntag_transceive(s, tx_read, sizeof(tx_read), rx, sizeof(rx), &rx_bits, RC522C_TIMEOUT_READ_US, 1));
     // NTAG21x section 10.2:
     // First, check for a NAK response (4 bits)
     char acknak = rx[0] & NTAG_ACKNAK_MASK;
     if (rx_bits == NTAG_ACKNAK_RX_BITS && acknak != NTAG_ACK)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_NAK, acknak);
-    // If the response is not a NAK, we expect 18 bytes (contents of 4 pages + CRC)
-    if (rx_bits != (RC522_READ_LEN + 2) * 8)
-        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
-    char crc[2];
-    compute_crc(&s->crc, rx, RC522_READ_LEN, crc);
-    if (crc[0] != rx[16] || crc[1] != rx[17])
+    // If the response is not a NAK, we expect 16 bytes (contents of 4 pages)
+    if (rx_bits != RC522_READ_LEN * 8)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
 
     memcpy(out, rx, RC522_READ_LEN);
+    shadow_store(s, (unsigned char)start_page, rx, RC522_READ_LEN / 4);
     return RC522C_STATUS_SUCCESS;
 }
 
+enum rc522c_status rc522c_ntag_read_range(struct rc522c_state* s, int start_page, int end_page, char* out)
+{
+    char rx[RC522_FAST_READ_MAX_PAGES * 4 + 2];
+    int rx_bits;
+
+    if (!s->tag_selected)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, 0);
+
+    // NTAG21x section 10.3: FAST_READ returns all pages from start_page to end_page (inclusive) in one response.
+    // Very long responses are split into several commands so that a single corrupted frame is cheap to repeat.
+    for (int page = start_page; page <= end_page; page += RC522_FAST_READ_MAX_PAGES)
+    {
+        int last_page = page + RC522_FAST_READ_MAX_PAGES - 1;
+        if (last_page > end_page)
+            last_page = end_page;
+        int data_len = (last_page - page + 1) * 4;
+
+        char tx_fast_read[3] = {NTAG_CMD_FAST_READ, page, last_page};
+        CHECK_RC522C_STATUS(s, ntag_transceive(s, tx_fast_read, sizeof(tx_fast_read), rx, sizeof(rx), &rx_bits,
+                                   RC522C_TIMEOUT_READ_US, 1));
+        // First, check for a NAK response (4 bits)
+        char acknak = rx[0] & NTAG_ACKNAK_MASK;
+        if (rx_bits == NTAG_ACKNAK_RX_BITS && acknak != NTAG_ACK)
+            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_NAK, acknak);
+        // If the response is not a NAK, we expect the contents of the requested pages
+        if (rx_bits != data_len * 8)
+            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
+
+        memcpy(&out[(page - start_page) * 4], rx, data_len);
+        shadow_store(s, page, rx, last_page - page + 1);
+    }
+
+    return RC522C_STATUS_SUCCESS;
+}
+
+void rc522c_ntag_build_write_frame(char* frame, int page, const char* in)
+{
+    frame[0] = NTAG_CMD_WRITE;
+    frame[1] = page;
+    memcpy(&frame[2], in, RC522_WRITE_LEN);
+    compute_crc(frame, 2 + RC522_WRITE_LEN, &frame[2 + RC522_WRITE_LEN]);
+}
+
 enum rc522c_status rc522c_ntag_write(struct rc522c_state* s, char page, const char* in)
 {
-    char rx[64];
+    char frame[RC522C_WRITE_FRAME_LEN];
+    rc522c_ntag_build_write_frame(frame, page, in);
+    return rc522c_ntag_write_frame(s, frame);
+}
+
+enum rc522c_status rc522c_ntag_write_frame(struct rc522c_state* s, const char* frame)
+{
+    char rx[RC522_FIFO_SIZE];
     int rx_bits;
+    const char* in = &frame[2];
 
     if (!s->tag_selected)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, 0);
 
-    char tx_write[8] = {NTAG_CMD_WRITE, page, in[0], in[1], in[2], in[3], 0};
-    compute_crc(&s->crc, tx_write, 6, &tx_write[6]);
-    CHECK_RC522C_STATUS(s, rc522c_transceive(s, tx_write, sizeof(tx_write) * 8, rx, &rx_bits));
+    // If the command fails, the page may or may not have been written
+    unsigned char shadow_page = frame[1];
+    if (shadow_page < NTAG_MAX_PAGES)
+        s->shadow_valid[shadow_page] = 0;
+
+    // The frame already carries CRC_A, which the chip computes by itself in hw_crc mode
+    enum rc522c_status status = s->hw_crc
+        ? ntag_transceive(s, frame, 2 + RC522_WRITE_LEN, rx, sizeof(rx), &rx_bits, RC522C_TIMEOUT_WRITE_US, 0)
+        : rc522c_transceive(s, frame, RC522C_WRITE_FRAME_LEN * 8, rx, sizeof(rx), &rx_bits, RC522C_TIMEOUT_WRITE_US, 0);
+    CHECK_RC522C_STATUS(s, status);
     // NTAG21x section 10.4: we expect 4 bits (ACK/NAK) in response. ACK is 0xA
     if (rx_bits != NTAG_ACKNAK_RX_BITS)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
@@ -295,31 +1194,147 @@ enum rc522c_status rc522c_ntag_write(struct rc522c_state* s, char page, const ch
     if (acknak != NTAG_ACK)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_NAK, acknak);
 
+    if (s->shadow_enabled && shadow_page < NTAG_MAX_PAGES && shadow_cacheable(s, shadow_page, 1))
+    {
+        memcpy(&s->shadow[shadow_page * 4], in, RC522_WRITE_LEN);
+        s->shadow_valid[shadow_page] = 1;
+    }
+
+    return RC522C_STATUS_SUCCESS;
+}
+
+enum rc522c_status rc522c_ntag_write_range(
+    struct rc522c_state* s, int start_page, const char* data, int len, int verify)
+{
+    if (!s->tag_selected)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, 0);
+    if (len == 0)
+        return RC522C_STATUS_SUCCESS;
+
+    int end_page = start_page + (len + 3) / 4 - 1;
+    if (start_page < 0 || len < 0 || end_page >= rc522c_ntag_page_count(s->tag_kind))
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_OUT_OF_RANGE, 0);
+
+    for (int page = start_page; page <= end_page; ++page)
+    {
+        const char* in = &data[(page - start_page) * 4];
+        int in_len = len - (page - start_page) * 4;
+        char merged[RC522_WRITE_LEN];
+        if (in_len < RC522_WRITE_LEN)
+        {
+            // Partial last page: keep the bytes past the end of data
+            if (s->shadow_enabled && s->shadow_valid[page])
+            {
+                memcpy(merged, &s->shadow[page * 4], RC522_WRITE_LEN);
+            }
+            else
+            {
+                char current[RC522_READ_LEN];
+                CHECK_RC522C_STATUS(s, rc522c_ntag_read(s, page, current));
+                memcpy(merged, current, RC522_WRITE_LEN);
+            }
+            memcpy(merged, in, in_len);
+            in = merged;
+        }
+        CHECK_RC522C_STATUS(s, rc522c_ntag_write(s, page, in));
+    }
+
+    if (!verify)
+        return RC522C_STATUS_SUCCESS;
+
+    // A single FAST_READ (split every RC522_FAST_READ_MAX_PAGES pages) instead of one READ per page
+    char readback[NTAG_MAX_PAGES * 4];
+    CHECK_RC522C_STATUS(s, rc522c_ntag_read_range(s, start_page, end_page, readback));
+    for (int page = start_page; page <= end_page; ++page)
+    {
+        int offset = (page - start_page) * 4;
+        int n = len - offset < RC522_WRITE_LEN ? len - offset : RC522_WRITE_LEN;
+        if (shadow_cacheable(s, page, 1) && memcmp(&readback[offset], &data[offset], n) != 0)
+            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_VERIFY_FAILED, page);
+    }
+
+    return RC522C_STATUS_SUCCESS;
+}
+
+enum rc522c_status rc522c_ntag_write_bytes(
+    struct rc522c_state* s, int offset, const char* data, int len, int* out_pages_written)
+{
+    if (out_pages_written)
+        *out_pages_written = 0;
+
+    if (!s->tag_selected)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, 0);
+    if (len == 0)
+        return RC522C_STATUS_SUCCESS;
+
+    int first_page = offset / 4;
+    int last_page = (offset + len - 1) / 4;
+    if (offset < 0 || len < 0 || last_page >= rc522c_ntag_page_count(s->tag_kind))
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_OUT_OF_RANGE, 0);
+
+    // Current contents of pages first_page...last_page. Whatever is not in the shadow is fetched with one FAST_READ,
+    // including shadowed pages in between: a longer response is cheaper than another command.
+    char pages[NTAG_MAX_PAGES * 4];
+    int missing_first = -1, missing_last = -1;
+    for (int page = first_page; page <= last_page; ++page)
+    {
+        if (s->shadow_enabled && s->shadow_valid[page])
+        {
+            memcpy(&pages[(page - first_page) * 4], &s->shadow[page * 4], 4);
+        }
+        else
+        {
+            if (missing_first < 0)
+                missing_first = page;
+            missing_last = page;
+        }
+    }
+    if (missing_first >= 0)
+        CHECK_RC522C_STATUS(s, rc522c_ntag_read_range(s, missing_first, missing_last,
+                                   &pages[(missing_first - first_page) * 4]));
+
+    for (int page = first_page; page <= last_page; ++page)
+    {
+        char* current = &pages[(page - first_page) * 4];
+        char updated[RC522_WRITE_LEN];
+        memcpy(updated, current, RC522_WRITE_LEN);
+        for (int i = 0; i < RC522_WRITE_LEN; ++i)
+        {
+            int pos = page * 4 + i - offset;
+            if (pos >= 0 && pos < len)
+                updated[i] = data[pos];
+        }
+
+        // Pages that don't read back what was written to them (PWD, PACK) are always written
+        if (memcmp(updated, current, RC522_WRITE_LEN) == 0 && shadow_cacheable(s, page, 0))
+            continue;
+
+        CHECK_RC522C_STATUS(s, rc522c_ntag_write(s, page, updated));
+        if (out_pages_written)
+            ++*out_pages_written;
+    }
+
     return RC522C_STATUS_SUCCESS;
 }
 
 enum rc522c_status rc522c_ntag_authenticate(struct rc522c_state* s, const char* pwd, char* out_pack)
 {
-    char rx[64];
+    char rx[RC522_FIFO_SIZE];
     int rx_bits;
 
     if (!s->tag_selected)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_MISSING, 0);
 
-    char tx_auth[7] = {NTAG_CMD_PWD_AUTH, pwd[0], pwd[1], pwd[2], pwd[3], 0};
-    compute_crc(&s->crc, tx_auth, 5, &tx_auth[5]);
-    CHECK_RC522C_STATUS(s, rc522c_transceive(s, tx_auth, sizeof(tx_auth) * 8, rx, &rx_bits));
+    char tx_auth[5] = {NTAG_CMD_PWD_AUTH, pwd[0], pwd[1], pwd[2], pwd[3]};
+    CHECK_RC522C_STATUS(
+        s, ntag_transceive(s, tx_auth, sizeof(tx_auth), rx, sizeof(rx), &rx_bits, RC522C_TIMEOUT_READ_US, 1));
     // NTAG21x section 10.7:
     // First, check for a NAK response (4 bits)
     char acknak = rx[0] & NTAG_ACKNAK_MASK;
     if (rx_bits == NTAG_ACKNAK_RX_BITS && acknak != NTAG_ACK)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_NAK, acknak);
-    // If the response is not a NAK, we expect 4 bytes (2-byte PACK + CRC)
-    if (rx_bits != 4 * 8)
-        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
-    char crc[2];
-    compute_crc(&s->crc, rx, 2, crc);
-    if (crc[0] != rx[2] || crc[1] != rx[3])
+    // If the response is not a NAK, we expect the 2-byte PACK
+    if (rx_bits != RC522_PACK_LEN * 8)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
 
     out_pack[0] = rx[0];
@@ -331,21 +1346,9 @@ enum rc522c_status rc522c_ntag_authenticate(struct rc522c_state* s, const char*
 enum rc522c_status rc522c_ntag_protect(
     struct rc522c_state* s, const char* pwd, const char* pack, int start_page, int rw)
 {
-    int config_start_page;
-    switch (s->tag_kind)
-    {
-    case RC522C_TAG_KIND_213:
-        config_start_page = 0x29;
-        break;
-    case RC522C_TAG_KIND_215:
-        config_start_page = 0x83;
-        break;
-    case RC522C_TAG_KIND_216:
-        config_start_page = 0xE3;
-        break;
-    default:
+    int config_start_page = rc522c_ntag_config_page(s->tag_kind);
+    if (config_start_page < 0)
         RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_TAG_UNSUPPORTED, 0);
-    }
 
     // Rewrite PWD
     CHECK_RC522C_STATUS(s, rc522c_ntag_write(s, config_start_page + 2, pwd));
@@ -374,34 +1377,243 @@ enum rc522c_status rc522c_ntag_protect(
     return RC522C_STATUS_SUCCESS;
 }
 
-enum rc522c_status rc522c_init(struct rc522c_state* s, int spi_baud_rate, int antenna_gain, int rst_pin)
+static enum rc522c_status run_op(struct rc522c_state* s, const struct rc522c_op* op)
 {
-    memset(s, 0, sizeof(struct rc522c_state));
-    init_crc16_ccitt(&s->crc);
+    switch (op->kind)
+    {
+    case RC522C_OP_SELECT:
+        return rc522c_ntag_select(s);
+    case RC522C_OP_RESELECT:
+        return rc522c_ntag_reselect(s);
+    case RC522C_OP_SELECT_NFCID:
+        return rc522c_ntag_select_nfcid(s, op->data);
+    case RC522C_OP_AUTH:
+        return rc522c_ntag_authenticate(s, op->data, op->out);
+    case RC522C_OP_READ_RANGE:
+        return rc522c_ntag_read_range(s, op->start_page, op->end_page, op->out);
+    case RC522C_OP_WRITE_RANGE:
+        return rc522c_ntag_write_range(s, op->start_page, op->data, op->len, op->flag);
+    case RC522C_OP_PROTECT:
+        return rc522c_ntag_protect(s, op->data, op->pack, op->start_page, op->flag);
+    default:
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_DEV_CMD_FAILED, op->kind);
+    }
+}
 
-    CHECK_PIGPIO(s, gpioInitialise());
-    CHECK_PIGPIO(s, (s->spi = spiOpen(0, spi_baud_rate, 0)));
+enum rc522c_status rc522c_run_script(struct rc522c_state* s, const struct rc522c_op* ops, int n, int* out_failed)
+{
+    for (int i = 0; i < n; i++)
+    {
+        enum rc522c_status status = run_op(s, &ops[i]);
+        if (status != RC522C_STATUS_SUCCESS)
+        {
+            *out_failed = i;
+            return status;
+        }
+    }
+    *out_failed = -1;
+    return RC522C_STATUS_SUCCESS;
+}
+
+// Clock rates tried by RC522C_SPI_BAUD_AUTO, starting with one that any sane wiring handles.
+// MFRC522 section 8.1.2: the SPI interface supports up to 10 Mbit/s.
+static const int spi_baud_steps[] = {1000000, 2000000, 4000000, 6000000, 8000000, 10000000};
+#define SPI_BAUD_STEP_COUNT ((int)(sizeof(spi_baud_steps) / sizeof(spi_baud_steps[0])))
+
+static enum rc522c_status set_spi_baud_rate(struct rc522c_state* s, int baud_rate)
+{
+    CHECK_RC522C_STATUS(s, s->transport->set_baud_rate(s, baud_rate));
+    s->spi_baud_rate = baud_rate;
+    return RC522C_STATUS_SUCCESS;
+}
+
+// Writes bit patterns to the timer reload registers (which are reprogrammed before every command anyway) and reads
+// them back along with the version register. ok is set to 0 on the first mismatch.
+static enum rc522c_status check_spi(struct rc522c_state* s, int* ok)
+{
+    static const unsigned char patterns[] = {0x55, 0xAA, 0x00, 0xFF, 0x0F, 0xF0, 0xA5, 0x5A, 0x01, 0x80};
+
+    *ok = 1;
+    for (int round = 0; round < 4; ++round)
+    {
+        for (int i = 0; i < (int)sizeof(patterns); i += 2)
+        {
+            struct spi_batch b;
+            spi_batch_init(&b);
+            char hi, lo, version;
+            spi_batch_write(&b, RC522_REG_TIMER_RELOAD_HI, patterns[i]);
+            spi_batch_write(&b, RC522_REG_TIMER_RELOAD_LO, patterns[i + 1]);
+            spi_batch_read(&b, RC522_REG_TIMER_RELOAD_HI, &hi);
+            spi_batch_read(&b, RC522_REG_TIMER_RELOAD_LO, &lo);
+            spi_batch_read(&b, RC522_REG_VERSION, &version);
+            CHECK_RC522C_STATUS(s, spi_batch_flush(s, &b));
+            if ((unsigned char)hi != patterns[i] || (unsigned char)lo != patterns[i + 1] || version != s->dev_version)
+            {
+                *ok = 0;
+                return RC522C_STATUS_SUCCESS;
+            }
+        }
+    }
+    return RC522C_STATUS_SUCCESS;
+}
 
-    s->rst_pin = rst_pin;
-    CHECK_PIGPIO(s, gpioSetMode(rst_pin, PI_OUTPUT));
+// RC522C_SPI_BAUD_AUTO, see rc522c_init. out_failed is set to 1 if a step failed its checks: garbled address bytes
+// may have written to other registers then, so the chip has to be reset and configured again.
+static enum rc522c_status tune_spi_baud_rate(struct rc522c_state* s, int* out_failed)
+{
+    int fastest = 0;
+    *out_failed = 0;
+    for (int i = 1; i < SPI_BAUD_STEP_COUNT; ++i)
+    {
+        int ok;
+        CHECK_RC522C_STATUS(s, set_spi_baud_rate(s, spi_baud_steps[i]));
+        CHECK_RC522C_STATUS(s, check_spi(s, &ok));
+        if (!ok)
+        {
+            *out_failed = 1;
+            break;
+        }
+        fastest = i;
+    }
+
+    s->timer_reload = -1;
+    return set_spi_baud_rate(s, spi_baud_steps[fastest > 0 ? fastest - 1 : 0]);
+}
 
+static enum rc522c_status hard_reset(struct rc522c_state* s)
+{
     // Chinese knock-offs (vresion register 0x37 returning 0x12) do not implement soft reset.
     // Before interfacing with the chip, perform a hard reset, just in case.
 
     // Set RST to LOW for at least 100ns (MFRC522 8.8.1); we'll wait for 10us
-    CHECK_PIGPIO(s, gpioWrite(rst_pin, PI_LOW));
-    gpioDelay(10);
+    CHECK_RC522C_STATUS(s, s->transport->set_rst(s, 0));
+    rc522c_sleep_us(10);
 
     // Set RST to HIGH and wait for the chip to start.
     // Testing shows that the chip doesn't reply until at least 200us have passed; we'll wait for 400us to be sure.
-    CHECK_PIGPIO(s, gpioWrite(rst_pin, PI_HIGH));
-    gpioDelay(400);
+    CHECK_RC522C_STATUS(s, s->transport->set_rst(s, 1));
+    rc522c_sleep_us(400);
+    return RC522C_STATUS_SUCCESS;
+}
+
+// Starts the timer by hand and waits for its interrupt on the IRQ pin. If the line isn't wired up, every command would
+// otherwise wait RC522_IRQ_WAIT_TIMEOUT_US before falling back to polling.
+static enum rc522c_status check_irq_line(struct rc522c_state* s)
+{
+    struct spi_batch b;
+    spi_batch_init(&b);
+    set_timeout(s, &b, RC522_IRQ_CHECK_TIMER_US);
+    spi_batch_write(&b, RC522_REG_COM_IRQ, 0x7F);
+    // Only TimerIRq is routed to the pin; transceive_begin restores the usual set
+    spi_batch_write(&b, RC522_REG_COM_IEN, 0x80 | 0x01);
+    // MFRC522 9.3.1.13: TStartNow
+    spi_batch_write(&b, RC522_REG_CTRL, 0x40);
+    s->transport->clear_irq(s);
+    CHECK_RC522C_STATUS(s, spi_batch_flush(s, &b));
+
+    int raised = s->transport->wait_irq(s, RC522_IRQ_WAIT_TIMEOUT_US);
+    CHECK_RC522C_STATUS(s, spi_write_byte(s, RC522_REG_COM_IRQ, 0x7F));
+    if (!raised)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_IRQ_MISSING, s->irq_pin);
+    return RC522C_STATUS_SUCCESS;
+}
 
-    return init_dev(s, antenna_gain);
+enum rc522c_status rc522c_init(struct rc522c_state* s, const struct rc522c_config* user_cfg)
+{
+    memset(s, 0, sizeof(struct rc522c_state));
+
+    // In the auto mode, the transport is opened with the slowest rate, and the clock is tuned once the chip is up
+    struct rc522c_config auto_cfg;
+    const struct rc522c_config* cfg = user_cfg;
+    int auto_baud = user_cfg->spi_baud_rate == RC522C_SPI_BAUD_AUTO;
+    if (auto_baud)
+    {
+        auto_cfg = *user_cfg;
+        auto_cfg.spi_baud_rate = spi_baud_steps[0];
+        cfg = &auto_cfg;
+    }
+    s->spi_baud_rate = cfg->spi_baud_rate;
+    s->rst_pin = cfg->rst_pin;
+    s->hw_crc = cfg->hw_crc;
+    s->irq_pin = -1;
+    s->transport_kind = cfg->transport;
+
+    switch (cfg->transport)
+    {
+    case RC522C_TRANSPORT_PIGPIO:
+#ifdef RC522C_NO_PIGPIO
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_SYSTEM, ENOTSUP);
+#else
+        CHECK_RC522C_STATUS(s, rc522c_transport_pigpio_open(s, cfg));
+        break;
+#endif
+    case RC522C_TRANSPORT_SPIDEV:
+        CHECK_RC522C_STATUS(s, rc522c_transport_spidev_open(s, cfg));
+        break;
+    case RC522C_TRANSPORT_EMULATOR:
+        CHECK_RC522C_STATUS(s, rc522c_transport_emu_open(s, cfg));
+        break;
+    default:
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_SYSTEM, EINVAL);
+    }
+
+    CHECK_RC522C_STATUS(s, hard_reset(s));
+    CHECK_RC522C_STATUS(s, init_dev(s, cfg->antenna_gain));
+    if (auto_baud)
+    {
+        int tune_failed;
+        CHECK_RC522C_STATUS(s, tune_spi_baud_rate(s, &tune_failed));
+        if (tune_failed)
+        {
+            CHECK_RC522C_STATUS(s, hard_reset(s));
+            CHECK_RC522C_STATUS(s, init_dev(s, cfg->antenna_gain));
+        }
+    }
+
+    if (s->irq_pin >= 0)
+        CHECK_RC522C_STATUS(s, check_irq_line(s));
+    return RC522C_STATUS_SUCCESS;
+}
+
+enum rc522c_status rc522c_recover(struct rc522c_state* s)
+{
+    if (!s->transport)
+        RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_SYSTEM, EINVAL);
+
+    // MFRC522 8.8.1: RST low for at least 100ns
+    CHECK_RC522C_STATUS(s, s->transport->set_rst(s, 0));
+    rc522c_sleep_us(10);
+    CHECK_RC522C_STATUS(s, s->transport->set_rst(s, 1));
+
+    // The chip reads back zeros until its oscillator is up. hard_reset sleeps for the worst case; here, the version
+    // register is polled instead, which gets the reader back as soon as the chip is.
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;)
+    {
+        char version = 0;
+        CHECK_RC522C_STATUS(s, spi_read_byte(s, RC522_REG_VERSION, &version));
+        if (version == s->dev_version)
+            break;
+        if (elapsed_us(&start) >= RC522C_RECOVER_TIMEOUT_US)
+            RETURN_RC522C_ERROR(s, RC522C_STATUS_ERROR_DEV_NOT_RESPONDING, 0);
+        rc522c_sleep_us(20);
+    }
+
+    struct spi_batch b;
+    spi_batch_init(&b);
+    config_batch(s, &b);
+    spi_batch_write(&b, RC522_REG_TX_CTRL, s->tx_ctrl);
+    CHECK_RC522C_STATUS(s, spi_batch_flush(s, &b));
+
+    // config_batch has forgotten the timer reload and Tx/RxModeReg values; the field went down with the antennas
+    s->tag_selected = 0;
+    return RC522C_STATUS_SUCCESS;
 }
 
 void rc522c_deinit(struct rc522c_state* s)
 {
-    spiClose(s->spi);
-    gpioTerminate();
+    if (s->transport)
+        s->transport->close(s);
+    s->transport = NULL;
 }
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "crc.h"
+#include <semaphore.h>
 
 // Data sheets/references:
 // MFRC522: https://www.nxp.com/docs/en/data-sheet/MFRC522.pdf
@@ -10,13 +10,18 @@
 // MFRC522 data sheet, section 9
 #define RC522_REG_CMD 0x01
 #define RC522_REG_COM_IEN 0x02
+#define RC522_REG_DIV_IEN 0x03
 #define RC522_REG_COM_IRQ 0x04
 #define RC522_REG_ERROR 0x06
 #define RC522_REG_FIFO_DATA 0x09
 #define RC522_REG_FIFO_LEVEL 0x0A
+#define RC522_REG_WATER_LEVEL 0x0B
 #define RC522_REG_CTRL 0x0C
 #define RC522_REG_BIT_FRAMING 0x0D
+#define RC522_REG_COLL 0x0E
 #define RC522_REG_MODE 0x11
+#define RC522_REG_TX_MODE 0x12
+#define RC522_REG_RX_MODE 0x13
 #define RC522_REG_TX_CTRL 0x14
 #define RC522_REG_TX_ASK 0x15
 #define RC522_REG_RECV_GAIN 0x26
@@ -26,20 +31,58 @@
 #define RC522_REG_TIMER_RELOAD_LO 0x2D
 #define RC522_REG_VERSION 0x37
 
+// MFRC522 data sheet, section 8.3
+#define RC522_FIFO_SIZE 64
+// Free space left in the FIFO when the HiAlert IRQ is raised, see section 9.3.1.12
+#define RC522_FIFO_WATER_LEVEL 32
+
+// Interrupts that assert the IRQ pin (MFRC522 9.3.1.3): 0x80 = IRQ is active low,
+// 0x20 = data received, 0x10 = command terminated, 0x8 = FIFO HiAlert, 0x2 = error, 0x1 = timer expired
+#define RC522_COM_IEN (0x80 | 0x3B)
+
+// How long to wait for an interrupt before falling back to polling. This is well above the RF timeout.
+#define RC522_IRQ_WAIT_TIMEOUT_US 50000
+// Timer run by rc522c_init to check that interrupts arrive on the IRQ pin
+#define RC522_IRQ_CHECK_TIMER_US 100
+
+// Timer prescaler, chosen so that one tick is ~10us and the 16-bit reload value covers timeouts up to ~650ms
+#define RC522_TIMER_PRESCALER 67
+
+// CRC_A handling for a command in hw_crc mode: the chip appends CRC_A to the request (TxCRCEn) and/or checks and
+// removes it from the response (RxCRCEn). MFRC522 sections 9.3.2.2 and 9.3.2.3.
+#define RC522C_CRC_TX 0x1
+#define RC522C_CRC_RX 0x2
+
 // MFRC522 data sheet, section 10
 #define RC522_CMD_IDLE 0x0
 #define RC522_CMD_TRANSCEIVE 0xC
 
 // NTAG21x data sheet, section 9
 #define NTAG_CMD_REQA 0x26
+#define NTAG_CMD_WUPA 0x52
 #define NTAG_CMD_CL1_SEL 0x93
 #define NTAG_CMD_CL2_SEL 0x95
 #define NTAG_CMD_SDD_REQ 0x20
 #define NTAG_CMD_SEL_REQ 0x70
 #define NTAG_CMD_READ 0x30
+#define NTAG_CMD_FAST_READ 0x3A
 #define NTAG_CMD_WRITE 0xA2
 #define NTAG_CMD_GET_VERSION 0x60
 #define NTAG_CMD_PWD_AUTH 0x1B
+#define NTAG_CMD_HLTA 0x50
+
+// Per-command RF timeouts (time from the end of transmission until the tag starts responding).
+// REQA, SDD and SEL are answered within ~100us (frame delay time, see NFC Digital Protocol);
+// READ/GET_VERSION/PWD_AUTH get a generous margin; WRITE needs to cover the EEPROM programming time
+// (4.1ms per the NTAG21x data sheet)
+#define RC522C_TIMEOUT_ANTICOLL_US 500
+// REQA sent while waiting for a tag: ATQA follows the REQA within ~90us (FDT = 1236/fc), and a tag that takes longer
+// is picked up by the next probe
+#define RC522C_TIMEOUT_PROBE_US 200
+// ISO/IEC 14443-3, section 5: a tag must be ready to receive commands within 5ms after the field is switched on
+#define RC522C_FIELD_GUARD_US 5100
+#define RC522C_TIMEOUT_READ_US 5000
+#define RC522C_TIMEOUT_WRITE_US 10000
 
 #define NTAG_VERSION_STORAGE_SIZE_BYTE 6
 #define NTAG_VERSION_STORAGE_SIZE_213 0x0F
@@ -60,6 +103,9 @@
 // NTAG21x has a 7-bit NFCID
 #define NTAG_NFCID_LEN 7
 
+// NTAG21x section 8.5: NTAG216 has the largest memory, 231 pages
+#define NTAG_MAX_PAGES 231
+
 #define NFC_CASCADE_TAG 0x88
 
 enum rc522c_status
@@ -70,7 +116,20 @@ enum rc522c_status
   RC522C_STATUS_ERROR_DEV_NOT_RESPONDING = -3,
   RC522C_STATUS_ERROR_TAG_MISSING = -4,
   RC522C_STATUS_ERROR_TAG_UNSUPPORTED = -5,
-  RC522C_STATUS_ERROR_TAG_NAK = -6
+  RC522C_STATUS_ERROR_TAG_NAK = -6,
+  // A system call failed, error_code is errno
+  RC522C_STATUS_ERROR_SYSTEM = -7,
+  // The requested pages lie outside the memory of the selected tag
+  RC522C_STATUS_ERROR_OUT_OF_RANGE = -8,
+  // Data read back after a write differs from what was written, error_code is the first mismatching page
+  RC522C_STATUS_ERROR_VERIFY_FAILED = -9,
+  // Several tags answered at once, error_code is the MFRC522 CollReg value
+  RC522C_STATUS_ERROR_TAG_COLLISION = -10,
+  // The tag doesn't hold a well-formed NDEF message (see ndef.h), error_code is the byte address where parsing stopped
+  RC522C_STATUS_ERROR_NDEF_INVALID = -11,
+  // rc522c_init made the chip raise an interrupt, but it didn't arrive on the IRQ pin (not wired, or wired to another
+  // GPIO); error_code is the pin
+  RC522C_STATUS_ERROR_IRQ_MISSING = -12
 };
 
 enum rc522c_tag_kind
@@ -81,18 +140,191 @@ enum rc522c_tag_kind
   RC522C_TAG_KIND_216
 };
 
+enum rc522c_transport_kind
+{
+  // pigpio library: requires root
+  RC522C_TRANSPORT_PIGPIO,
+  // Linux spidev and GPIO character devices: only requires access to /dev/spidevX.Y and /dev/gpiochipN
+  RC522C_TRANSPORT_SPIDEV,
+  // Software model of the chip and an NTAG21x tag (see emu.h), for testing and benchmarking without hardware
+  RC522C_TRANSPORT_EMULATOR
+};
+
+#define RC522C_DEFAULT_SPI_DEVICE_FORMAT "/dev/spidev%d.%d"
+#define RC522C_DEFAULT_GPIO_CHIP "/dev/gpiochip0"
+
+// rc522c_config.spi_baud_rate: pick the clock automatically, see rc522c_init
+#define RC522C_SPI_BAUD_AUTO 0
+
+struct rc522c_config
+{
+    enum rc522c_transport_kind transport;
+    // Chip select line: CE0/CE1 on the main SPI bus, CE0...CE2 on the auxiliary bus
+    int spi_channel;
+    // 1 to use the auxiliary SPI bus (SPI1 on Raspberry Pi) instead of the main one
+    int spi_aux;
+    // SPI clock in Hz, or RC522C_SPI_BAUD_AUTO
+    int spi_baud_rate;
+    // antenna_gain _must_ be in 0..7 range
+    int antenna_gain;
+    // 1 to have the MFRC522 append and check CRC_A (TxCRCEn/RxCRCEn), 0 to compute it in software
+    int hw_crc;
+    // GPIO pin number for RST (for RC522C_TRANSPORT_SPIDEV, line offset on gpio_chip)
+    int rst_pin;
+    // GPIO pin number for IRQ, -1 if not connected. rc522c_init checks that interrupts arrive on it.
+    int irq_pin;
+    // RC522C_TRANSPORT_SPIDEV only. NULL selects /dev/spidevB.C (B = spi_aux, C = spi_channel) and
+    // RC522C_DEFAULT_GPIO_CHIP
+    const char* spi_device;
+    const char* gpio_chip;
+    // RC522C_TRANSPORT_EMULATOR only: emulator instance (owned by the caller),
+    // NULL to create one with an NTAG215 in the field
+    struct rc522c_emu* emu;
+};
+
+struct rc522c_state;
+struct rc522c_emu;
+
+// Commands tracked separately in rc522c_stats
+enum rc522c_stats_cmd
+{
+  RC522C_STATS_REQA,
+  RC522C_STATS_WUPA,
+  RC522C_STATS_SDD,
+  RC522C_STATS_SEL,
+  RC522C_STATS_GET_VERSION,
+  RC522C_STATS_READ,
+  RC522C_STATS_FAST_READ,
+  RC522C_STATS_WRITE,
+  RC522C_STATS_PWD_AUTH,
+  RC522C_STATS_HLTA,
+  RC522C_STATS_OTHER,
+  RC522C_STATS_CMD_COUNT
+};
+
+// Bucket i of the latency histogram counts commands that took 2^i...2^(i+1)-1 microseconds. The first bucket also
+// counts faster ones, the last one slower ones.
+#define RC522C_STATS_LATENCY_BUCKETS 16
+
+struct rc522c_cmd_stats
+{
+    // Transceives of this command, and how many of them were repeats issued by the driver itself
+    // (anticollision rounds after a collision)
+    unsigned int count;
+    unsigned int retries;
+    // SPI transactions, and COM_IRQ reads while waiting for the command to complete
+    unsigned int spi_xfers;
+    unsigned int polls;
+    // The tag didn't answer in time (for HLTA, that's the expected outcome)
+    unsigned int timeouts;
+    // Several tags answered at once
+    unsigned int collisions;
+    // NAKs by code (NTAG21x section 9.3)
+    unsigned int naks[16];
+    // Other failures: device errors, malformed responses
+    unsigned int errors;
+    // Time from sending the command until the response has been read out
+    unsigned long long total_us;
+    unsigned int max_us;
+    unsigned int latency_hist[RC522C_STATS_LATENCY_BUCKETS];
+};
+
+// Counters kept by every reader since rc522c_init or the last rc522c_stats_reset. They cost two clock reads per
+// command, so they're always on.
+struct rc522c_stats
+{
+    struct rc522c_cmd_stats cmds[RC522C_STATS_CMD_COUNT];
+    // Interrupts that didn't arrive in time. The first one switches the reader over to polling COM_IRQ for good
+    // (see rc522c_state.irq_broken), so this is 0 on a healthy line and 1 on one that has stopped working.
+    unsigned int irq_lost;
+};
+
+// A single SPI transaction (chip select is asserted for its duration)
+struct rc522c_spi_xfer
+{
+    const char* tx;
+    // May be NULL if the received bytes are not needed
+    char* rx;
+    int len;
+};
+
+// Maximum number of transactions passed to rc522c_transport.xfer at once
+#define RC522C_SPI_BATCH_MAX 16
+
+struct rc522c_transport
+{
+    // Performs n SPI transactions in order, in as few system calls as the backend allows
+    enum rc522c_status (*xfer)(struct rc522c_state* s, const struct rc522c_spi_xfer* xfers, int n);
+    enum rc522c_status (*set_rst)(struct rc522c_state* s, int level);
+    // Discards IRQ pin edges seen so far
+    void (*clear_irq)(struct rc522c_state* s);
+    // Blocks until the IRQ pin is asserted; returns 0 if it was not asserted within timeout_us
+    int (*wait_irq)(struct rc522c_state* s, int timeout_us);
+    // Changes the SPI clock for the following transactions
+    enum rc522c_status (*set_baud_rate)(struct rc522c_state* s, int baud_rate);
+    void (*close)(struct rc522c_state* s);
+};
+
 struct rc522c_state
 {
-    // pigpio handle for SPI device access
-    int spi;
+    // SPI/GPIO access, set up by rc522c_init
+    const struct rc522c_transport* transport;
+    union
+    {
+        struct
+        {
+            // pigpio handle for SPI device access, and what it was opened with
+            int spi;
+            unsigned spi_channel;
+            unsigned spi_flags;
+            // Posted by the IRQ pin ISR
+            sem_t irq_sem;
+        } pigpio;
+        struct
+        {
+            int spi_fd;
+            int spi_speed_hz;
+            // Line handle for RST, line event handle for IRQ
+            int rst_fd;
+            int irq_fd;
+        } spidev;
+        struct
+        {
+            struct rc522c_emu* emu;
+            // Whether emu was created by rc522c_init and needs to be freed
+            int owned;
+        } emu;
+    } tr;
+    enum rc522c_transport_kind transport_kind;
+
+    // SPI clock in use (Hz). With RC522C_SPI_BAUD_AUTO, this is the rate rc522c_init settled on.
+    int spi_baud_rate;
+
     // GPIO pin number for RST
     int rst_pin;
+    // GPIO pin number for IRQ, -1 if not connected (COM_IRQ is polled instead)
+    int irq_pin;
+    // Set once an interrupt has been lost. COM_IRQ is polled from then on, rather than every command waiting
+    // RC522_IRQ_WAIT_TIMEOUT_US for an edge that doesn't come.
+    int irq_broken;
+
+    // Current timer reload value (RF timeout), -1 if unknown
+    long timer_reload;
+
+    // Whether CRC_A is computed by the chip (see rc522c_config.hw_crc), and the RC522C_CRC_* flags currently
+    // programmed into TxModeReg/RxModeReg (-1 if unknown)
+    int hw_crc;
+    int crc_mode;
 
     // Chip version
     // MFRC522 data sheet, section 9.3.4.8 lists two versions: 0x91 and 0x92.
     // There's also a Chinese chip with version 0x12
     char dev_version;
 
+    // Configuration replayed by rc522c_recover: receiver gain and TxControlReg with the antennas enabled
+    int antenna_gain;
+    char tx_ctrl;
+
     // Is there an active (selected) tag?
     int tag_selected;
 
@@ -104,32 +336,186 @@ struct rc522c_state
     // NTAG21x type. Valid when tag_selected is 1.
     enum rc522c_tag_kind tag_kind;
 
+    // Whether tag_nfcid and tag_kind describe the last successfully selected tag, even if it's not selected anymore.
+    // Such a tag can be selected again with rc522c_ntag_reselect.
+    int tag_known;
+
+    // Shadow copy of the selected tag's memory, see rc522c_ntag_set_shadow.
+    // Pages are filled in by reads and writes; the whole shadow is dropped when a tag is (re)selected.
+    int shadow_enabled;
+    char shadow[NTAG_MAX_PAGES * 4];
+    char shadow_valid[NTAG_MAX_PAGES];
+
     // In case rc522c_status is _not_ RC522C_STATUS_SUCCESS:
-    // Line in rc522.c where the error originated
+    // Source file and line where the error originated
+    const char* error_file;
     int error_line;
-    // Context-specific error code (e.g. pigpio error code)
+    // Context-specific error code (e.g. pigpio error code or errno)
     int error_code;
 
-    // Internal
-    struct crc16_ccitt crc;
+    // Number of SPI transactions issued since rc522c_init.
+    // Sample it before and after a command to find out how many transactions the command costs.
+    unsigned int spi_xfer_count;
+    // Number of COM_IRQ reads in the completion loop since rc522c_init
+    unsigned int poll_count;
+
+    struct rc522c_stats stats;
 };
 
+// Selects a tag in the field. If there are several, bit-level anticollision picks one of them
+// (see rc522c_ntag_inventory to find all of them).
 enum rc522c_status rc522c_ntag_select(struct rc522c_state* s);
 
+// Selects the last selected tag again (e.g. after a NAK or a failed authentication returned it to IDLE):
+// WUPA and the two SEL_REQs built from the cached NFCID. Skips both SDD rounds and GET_VERSION, so it takes three
+// transceives instead of six. Fails with RC522C_STATUS_ERROR_TAG_MISSING if no tag was selected before or
+// the tag has left the field.
+enum rc522c_status rc522c_ntag_reselect(struct rc522c_state* s);
+
+// Runs rc522c_ntag_select on several readers at once. The REQA probes are interleaved: all readers are sent REQA
+// before any of them is polled for the response, so the RF waits overlap. Readers that get an answer then complete
+// the selection one after another. out_selected[i] is set to 1 if a tag was selected on readers[i].
+// Tag errors just leave out_selected[i] at 0, as does a reader whose REQA hasn't completed after
+// RC522_IRQ_WAIT_TIMEOUT_US (it's put back to idle). Other errors stop the whole operation; out_failed is then set to
+// the index of the reader whose state holds the error details (-1 otherwise).
+#define RC522C_MULTI_MAX_READERS 8
+enum rc522c_status rc522c_ntag_select_multi(struct rc522c_state** readers, int n, int* out_selected, int* out_failed);
+
+// Switches the antennas on (as rc522c_init leaves them) or off. Tags lose power, and their state, while the field
+// is off; after switching it on, give them RC522C_FIELD_GUARD_US before sending commands.
+enum rc522c_status rc522c_set_antenna(struct rc522c_state* s, int on);
+
+// Waits until a tag enters the field and selects it. Every interval_us, a REQA with a short timeout
+// (RC522C_TIMEOUT_PROBE_US) probes the field, and anticollision only starts once something answers. If interval_us
+// is longer than RC522C_FIELD_GUARD_US, the antennas are switched off between probes and switched on again
+// RC522C_FIELD_GUARD_US before each probe, so the field is only on for a few milliseconds per interval; shorter
+// intervals keep the field on and just sleep. The call returns as soon as a tag has been selected, or with
+// RC522C_STATUS_ERROR_TAG_MISSING once timeout_us has passed (-1 waits forever); there's no probe at the very end,
+// so back-to-back calls with timeout_us a multiple of interval_us keep probing every interval_us. The field is left on.
+enum rc522c_status rc522c_ntag_wait_for_tag(struct rc522c_state* s, int timeout_us, int interval_us);
+
+// Selects the tag with the given NFCID (NTAG_NFCID_LEN bytes), e.g. one found by rc522c_ntag_inventory: WUPA and the two
+// SEL_REQs, followed by GET_VERSION. Other tags in the field stay in (or return to) HALT or IDLE.
+enum rc522c_status rc522c_ntag_select_nfcid(struct rc522c_state* s, const char* nfcid);
+
+struct rc522c_ntag_info
+{
+    char nfcid[NTAG_NFCID_LEN];
+    enum rc522c_tag_kind kind;
+};
+
+// Finds the NTAG21x tags in the field, up to max_tags of them: each one is selected in turn (resolving collisions bit by
+// bit) and then halted with HLTA, so that the next REQA is only answered by the rest. out_count receives the number of
+// tags found. Tags are left in HALT, where rc522c_ntag_select doesn't see them; use rc522c_ntag_select_nfcid.
+enum rc522c_status rc522c_ntag_inventory(
+    struct rc522c_state* s, struct rc522c_ntag_info* out, int max_tags, int* out_count);
+
+// Sends HLTA to the selected tag (NFC Digital Protocol, section 4.9). A halted tag ignores REQA, so it isn't picked up
+// by rc522c_ntag_select or rc522c_ntag_wait_for_tag again until it leaves the field; WUPA wakes it up.
+enum rc522c_status rc522c_ntag_halt(struct rc522c_state* s);
+
+// Checks that the selected tag is still in the field, keeping it selected (and authenticated) if it is.
+// Otherwise, the tag is no longer considered selected; rc522c_ntag_reselect can bring it back if it returns.
+enum rc522c_status rc522c_ntag_present(struct rc522c_state* s);
+
+// NTAG21x section 8.5: number of pages in the tag memory, 0 for unknown tags
+int rc522c_ntag_page_count(enum rc522c_tag_kind kind);
+
 // A single NFC read command returns 16 bytes (4 pages) of data
 #define RC522_READ_LEN 16
 enum rc522c_status rc522c_ntag_read(struct rc522c_state* s, char start_page, char* out);
 
+// Reads pages start_page...end_page (inclusive) using as few FAST_READ commands as possible.
+// out _must_ be able to fit (end_page - start_page + 1) * 4 bytes
+#define RC522_FAST_READ_MAX_PAGES 64
+enum rc522c_status rc522c_ntag_read_range(struct rc522c_state* s, int start_page, int end_page, char* out);
+
 #define RC522_WRITE_LEN 4
 enum rc522c_status rc522c_ntag_write(struct rc522c_state* s, char page, const char* in);
 
+// WRITE command frame (command, page, data, CRC_A) for rc522c_ntag_write_frame. Frames that are sent to many tags
+// can be built once, saving the CRC computation on every write.
+#define RC522C_WRITE_FRAME_LEN (2 + RC522_WRITE_LEN + 2)
+void rc522c_ntag_build_write_frame(char* frame, int page, const char* in);
+// Same as rc522c_ntag_write, with the frame built by rc522c_ntag_build_write_frame
+enum rc522c_status rc522c_ntag_write_frame(struct rc522c_state* s, const char* frame);
+
+// Writes len bytes starting at start_page, one WRITE command per page. If len is not a multiple of 4,
+// the rest of the last page is read first and left unchanged.
+// If verify is 1, the data is read back with FAST_READ afterwards. PWD, PACK, lock bytes and the capability container
+// don't read back what was written to them and are not verified.
+enum rc522c_status rc522c_ntag_write_range(
+    struct rc522c_state* s, int start_page, const char* data, int len, int verify);
+
+// Enables or disables the shadow copy of the selected tag's memory. Either way, the current shadow is dropped.
+// With the shadow enabled, rc522c_ntag_write_bytes does not need to read back pages it has already seen.
+// Enable it only if nothing else writes to the tag while it stays selected.
+void rc522c_ntag_set_shadow(struct rc522c_state* s, int enabled);
+
+// Writes len bytes at the given byte offset into the tag memory, issuing WRITE commands only for the pages
+// whose contents change. Pages missing from the shadow are fetched with a single FAST_READ first.
+// If out_pages_written is not NULL, it receives the number of WRITE commands issued.
+enum rc522c_status rc522c_ntag_write_bytes(
+    struct rc522c_state* s, int offset, const char* data, int len, int* out_pages_written);
+
 #define RC522_PWD_LEN 4
 #define RC522_PACK_LEN 2
 enum rc522c_status rc522c_ntag_authenticate(struct rc522c_state* s, const char* pwd, char* out_pack);
 
 enum rc522c_status rc522c_ntag_protect(struct rc522c_state* s, const char* pwd, const char* pack, int start_page, int rw);
 
-// antenna_gain _must_ be in 0..7 range
-enum rc522c_status rc522c_init(struct rc522c_state* s, int spi_baud_rate, int antenna_gain, int rst_pin);
+// A step of a script run by rc522c_run_script. Unused fields are ignored.
+enum rc522c_op_kind
+{
+  // rc522c_ntag_select
+  RC522C_OP_SELECT,
+  // rc522c_ntag_reselect
+  RC522C_OP_RESELECT,
+  // rc522c_ntag_select_nfcid with data as the NFCID
+  RC522C_OP_SELECT_NFCID,
+  // rc522c_ntag_authenticate with data as the password, the PACK goes to out
+  RC522C_OP_AUTH,
+  // rc522c_ntag_read_range of start_page...end_page into out
+  RC522C_OP_READ_RANGE,
+  // rc522c_ntag_write_range of len bytes of data at start_page, verified if flag is 1
+  RC522C_OP_WRITE_RANGE,
+  // rc522c_ntag_protect with data as the password, pack, start_page, and flag as rw
+  RC522C_OP_PROTECT
+};
+
+struct rc522c_op
+{
+    enum rc522c_op_kind kind;
+    int start_page;
+    int end_page;
+    const char* data;
+    int len;
+    const char* pack;
+    int flag;
+    char* out;
+};
+
+// Runs n operations one after another, stopping at the first one that fails. out_failed receives the index of the
+// failed operation, or -1 if all of them succeeded. Lets a whole transaction (select, authenticate, write, read)
+// be issued with a single call, e.g. from an interpreter that has to be left and re-entered around every call.
+enum rc522c_status rc522c_run_script(struct rc522c_state* s, const struct rc522c_op* ops, int n, int* out_failed);
+
+// Resets and configures the chip. With spi_baud_rate = RC522C_SPI_BAUD_AUTO, the chip is brought up at 1 MHz, then
+// the clock is stepped up (2, 4, 6, 8, 10 MHz; the MFRC522 is specified for up to 10 Mbit/s) with write/read-back
+// checks of the timer reload registers at each step. The first failure ends the search, and the reader settles one
+// step below the fastest rate that passed, as a safety margin. s->spi_baud_rate holds the chosen rate.
+enum rc522c_status rc522c_init(struct rc522c_state* s, const struct rc522c_config* cfg);
+
+// Brings a wedged chip back without closing the transport: pulses RST, polls the version register until the chip
+// answers (rather than sleeping for the worst case) and replays the configuration written by rc522c_init in a single
+// SPI batch. The SPI clock stays as it is. The reset powers the field down, so a selected tag is dropped;
+// rc522c_ntag_reselect can bring it back.
+#define RC522C_RECOVER_TIMEOUT_US 5000
+enum rc522c_status rc522c_recover(struct rc522c_state* s);
 
 void rc522c_deinit(struct rc522c_state* s);
+
+// Clears s->stats
+void rc522c_stats_reset(struct rc522c_state* s);
+// Command name for reports, e.g. "FAST_READ"
+const char* rc522c_stats_cmd_name(enum rc522c_stats_cmd cmd);
@@ -1,13 +1,35 @@
 from distutils.core import setup, Extension
+import os
 import sysconfig
 
 extra_compile_args = sysconfig.get_config_var("CFLAGS").split()
 extra_compile_args += ["-Wall", "-Wextra", "-Wpedantic"]
 
+sources = [
+    "pyinterface.c",
+    "rc522c.c",
+    "transport_pigpio.c",
+    "transport_spidev.c",
+    "emu.c",
+    "ndef.c",
+    "monitor.c",
+    "provision.c",
+    "crc.c",
+]
+libraries = ["pigpio"]
+define_macros = []
+# Set RC522PI_NO_PIGPIO=1 to build without pigpio (e.g. on a CI machine); only the spidev and emulator
+# transports are available then
+if os.environ.get("RC522PI_NO_PIGPIO"):
+    sources.remove("transport_pigpio.c")
+    libraries = []
+    define_macros = [("RC522C_NO_PIGPIO", None)]
+
 mod = Extension(
     "rc522pi",
-    sources=["pyinterface.c", "rc522c.c", "crc.c"],
-    libraries=["pigpio"],
+    sources=sources,
+    libraries=libraries,
+    define_macros=define_macros,
     extra_compile_args=extra_compile_args,
 )
 
@@ -0,0 +1,327 @@
+# Regression checks that run the driver against the emulator transport, so they need no hardware:
+# RC522PI_NO_PIGPIO=1 python3 setup.py build_ext --inplace && python3 -m unittest discover -s tests
+
+import asyncio
+import select
+import threading
+import time
+import unittest
+
+from rc522pi import RC522, AsyncRC522, RC522TagError, TagMonitor
+
+NFCID = bytes([0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66])
+
+# Chosen so that anticollision has to resolve collisions at various bit positions, in both cascade levels
+INVENTORY = [
+    (bytes([0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66]), "NTAG213"),
+    (bytes([0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x67]), "NTAG215"),  # differs in the last bit of CL2
+    (bytes([0x04, 0x91, 0x22, 0x33, 0x00, 0x00, 0x01]), "NTAG216"),  # differs in CL1
+    (bytes([0x04, 0x11, 0x23, 0x33, 0x44, 0x55, 0x66]), "NTAG213"),
+    (bytes([0x04, 0x11, 0x22, 0xB3, 0x44, 0x55, 0x66]), "NTAG215"),
+]
+
+
+class EmulatorTest(unittest.TestCase):
+    hw_crc = False
+
+    def setUp(self):
+        self.r = RC522(spi_baud_rate=1_000_000, antenna_gain=4, rst_pin=25, transport="emulator", hw_crc=self.hw_crc)
+
+    def place(self, kind="NTAG215", nfcid=NFCID):
+        self.r.emu_place_tag(kind, nfcid)
+        self.assertTrue(self.r.ntag_try_select())
+
+    def test_select(self):
+        self.place()
+        self.assertEqual(self.r.tag_nfcid, NFCID)
+        self.assertEqual(self.r.tag_kind, "NTAG215")
+        # Pages 0 and 1 hold the NFCID, split by the BCC0 check byte
+        page0 = self.r.ntag_read(0)
+        self.assertEqual(page0[:3], NFCID[:3])
+        self.assertEqual(page0[4:8], NFCID[3:])
+
+        # A tag that comes back is selected again without anticollision
+        self.r.emu_place_tag("NTAG215", NFCID)
+        self.assertTrue(self.r.ntag_try_reselect())
+        self.assertEqual(self.r.ntag_read(0), page0)
+
+        self.r.emu_remove_tag()
+        self.assertFalse(self.r.ntag_try_select())
+
+    def test_irq_fallback(self):
+        r = RC522(spi_baud_rate=1_000_000, antenna_gain=4, rst_pin=25, transport="emulator", irq_pin=24,
+            hw_crc=self.hw_crc)
+        self.assertTrue(r.ntag_try_select())
+        self.assertEqual(r.stats()["irq_lost"], 0)
+        # Once an interrupt is lost, the reader polls instead of waiting for each of the following ones in vain
+        r.emu_set_irq_connected(False)
+        for _ in range(5):
+            r.ntag_read(4)
+        self.assertEqual(r.stats()["irq_lost"], 1)
+
+    def test_select_collision(self):
+        self.r.emu_place_tag("NTAG215", INVENTORY[0][0])
+        self.r.emu_add_tag("NTAG215", INVENTORY[1][0])
+        self.assertTrue(self.r.ntag_try_select())
+        self.assertIn(self.r.tag_nfcid, (INVENTORY[0][0], INVENTORY[1][0]))
+
+    def test_inventory(self):
+        self.r.emu_place_tag(INVENTORY[0][1], INVENTORY[0][0])
+        for nfcid, kind in INVENTORY[1:]:
+            self.r.emu_add_tag(kind, nfcid)
+        self.assertEqual(sorted(self.r.ntag_inventory()), sorted(INVENTORY))
+
+        # Every tag is left halted, but can still be selected by NFCID
+        self.assertFalse(self.r.ntag_try_select())
+        for nfcid, kind in INVENTORY:
+            self.assertTrue(self.r.ntag_try_select_nfcid(nfcid))
+            self.assertEqual(self.r.tag_kind, kind)
+            self.r.ntag_write(4, nfcid[:4])
+            self.assertEqual(self.r.ntag_read(4)[:4], nfcid[:4])
+        self.assertFalse(self.r.ntag_try_select_nfcid(bytes(7)))
+
+    def test_write_bytes(self):
+        self.place()
+        data = bytes(range(40))
+        self.assertEqual(self.r.ntag_write_bytes(16, data), 10)
+        self.assertEqual(self.r.ntag_read_range(4, 13), data)
+        # Unchanged pages are skipped
+        self.assertEqual(self.r.ntag_write_bytes(16, data), 0)
+        self.assertEqual(self.r.ntag_write_bytes(21, b"\xff\xff\xff\xff"), 2)
+        self.assertEqual(self.r.ntag_read(5)[:8], bytes([4, 0xFF, 0xFF, 0xFF, 0xFF, 9, 10, 11]))
+
+    def test_ndef_round_trip(self):
+        self.place("NTAG216")
+        uri = b"\xd1\x01\x1a\x55\x04" + b"example.com/ticket/12345678"
+        self.r.ntag_ndef_write(uri)
+        self.assertEqual(self.r.ntag_ndef_read(), uri)
+        # A one-byte change only rewrites the page it's in
+        self.assertEqual(self.r.ntag_ndef_write(uri[:-1] + b"9"), 1)
+        self.assertEqual(self.r.ntag_ndef_read(), uri[:-1] + b"9")
+
+        longest = b"x" * 867
+        self.r.ntag_ndef_write(longest)
+        self.assertEqual(self.r.ntag_ndef_read(), longest)
+        with self.assertRaises(ValueError):
+            self.r.ntag_ndef_write(longest + b"x")
+        # A message written elsewhere may fill the whole data area, leaving no room for a Terminator TLV; it's
+        # longer than the read buffer and has to be rejected rather than copied
+        self.r.ntag_write_range(4, b"\x03\xff\x03\x64" + b"x" * 868)
+        with self.assertRaises(RC522TagError):
+            self.r.ntag_ndef_read()
+
+        # NULL TLVs and a Lock Control TLV in front of the message are skipped
+        self.r.ntag_write_range(4, b"\x00\x00\x01\x03\xa0\x10\x44\x03\x03abc\xfe")
+        self.assertEqual(self.r.ntag_ndef_read(), b"abc")
+        self.r.ntag_write_range(4, b"\xfe")
+        with self.assertRaises(RC522TagError):
+            self.r.ntag_ndef_read()
+
+    def test_provision(self):
+        image = bytes(range(48))
+        pwd, pack = b"\xab\x06\x05\xff", b"\xb0\xba"
+        self.r.provision_setup(image, pwd=pwd, pack=pack)
+        self.r.emu_place_tag("NTAG215", NFCID)
+        report = self.r.provision_next(timeout=1)
+        self.assertIsNone(report["error"])
+        self.assertEqual(report["nfcid"], NFCID)
+        self.assertEqual(report["pages_written"], len(image) // 4 + 4)
+        self.assertEqual(report["pwd"], bytes(a ^ b for a, b in zip(pwd, NFCID)))
+        self.assertEqual(report["pack"], bytes(a ^ b for a, b in zip(pack, NFCID)))
+        # The tag is halted, so it isn't provisioned twice
+        self.assertIsNone(self.r.provision_next(timeout=0.05))
+
+        self.assertTrue(self.r.ntag_try_select_nfcid(NFCID))
+        with self.assertRaises(RC522TagError):
+            self.r.ntag_read(4)
+        self.assertTrue(self.r.ntag_try_select_nfcid(NFCID))
+        self.assertEqual(self.r.ntag_authenticate(report["pwd"]), report["pack"])
+        self.assertEqual(self.r.ntag_read_range(4, 15), image)
+
+        # Tag errors are reported rather than raised
+        self.r.emu_place_tag("NTAG213", NFCID)
+        report = self.r.provision_next(timeout=1)
+        self.assertIsInstance(report["error"], RC522TagError)
+        self.assertEqual(report["pages_written"], 0)
+
+
+class EmulatorHardwareCrcTest(EmulatorTest):
+    hw_crc = True
+
+
+class TagMonitorTest(unittest.TestCase):
+    INTERVAL = 0.02
+    INTERVAL_NS = int(INTERVAL * 1e9)
+
+    def setUp(self):
+        self.r = RC522(spi_baud_rate=1_000_000, antenna_gain=4, rst_pin=25, transport="emulator")
+        self.r.emu_remove_tag()
+
+    def start(self, **kwargs):
+        monitor = TagMonitor(self.r, interval=self.INTERVAL, **kwargs)
+        self.addCleanup(monitor.close)
+        return monitor
+
+    def collect(self, monitor, polls, until=None):
+        """Returns the events published over the given number of polls (or until one of kind until), each along with
+        the time it was picked up"""
+        events = []
+        deadline = time.monotonic() + polls * self.INTERVAL
+        while time.monotonic() < deadline and not (until and events and events[-1][0][0] == until):
+            select.select([monitor], [], [], max(deadline - time.monotonic(), 0))
+            now = time.monotonic_ns()
+            events += [(event, now) for event in monitor.events()]
+        return events
+
+    def test_arrival_debounce(self):
+        monitor = self.start(arrive_polls=4, remove_polls=2)
+        # A tag that's only seen on a couple of polls isn't reported
+        self.r.emu_place_tag("NTAG215", NFCID)
+        time.sleep(self.INTERVAL * 1.5)
+        self.r.emu_remove_tag()
+        self.assertEqual(self.collect(monitor, 8), [])
+
+        placed = time.monotonic_ns()
+        self.r.emu_place_tag("NTAG215", NFCID)
+        events = self.collect(monitor, 10, until="arrived")
+        self.assertEqual([event[0] for event, _ in events], ["arrived"])
+        (_, timestamp, nfcid, kind), seen = events[0]
+        self.assertEqual((nfcid, kind), (NFCID, "NTAG215"))
+        # Stamped with the first poll that saw the tag, and published arrive_polls polls later
+        self.assertGreaterEqual(timestamp, placed - self.INTERVAL_NS)
+        self.assertLess(timestamp, placed + 2 * self.INTERVAL_NS)
+        self.assertGreaterEqual(seen - timestamp, 3 * self.INTERVAL_NS * 0.9)
+
+    def test_removal(self):
+        monitor = self.start(arrive_polls=1, remove_polls=3)
+        self.r.emu_place_tag("NTAG215", NFCID)
+        self.assertEqual([event[0] for event, _ in self.collect(monitor, 10, until="arrived")], ["arrived"])
+
+        removed = time.monotonic_ns()
+        self.r.emu_remove_tag()
+        events = self.collect(monitor, 12, until="removed")
+        self.assertEqual([event[0] for event, _ in events], ["removed"])
+        (_, timestamp, nfcid, _), seen = events[0]
+        self.assertEqual(nfcid, NFCID)
+        # Stamped with the first poll that missed the tag, not the one that made the removal final
+        self.assertGreaterEqual(timestamp, removed - self.INTERVAL_NS)
+        self.assertLess(timestamp, removed + 2 * self.INTERVAL_NS)
+        self.assertGreaterEqual(seen - timestamp, 2 * self.INTERVAL_NS * 0.9)
+
+    def test_no_spurious_events(self):
+        monitor = self.start(arrive_polls=2, remove_polls=2)
+        self.r.emu_place_tag("NTAG215", NFCID)
+        self.assertEqual([event[0] for event, _ in self.collect(monitor, 10, until="arrived")], ["arrived"])
+
+        # Neither a tag that stays put nor the application talking to it produces more events
+        page = self.r.ntag_read(4)
+        deadline = time.monotonic() + 20 * self.INTERVAL
+        while time.monotonic() < deadline:
+            self.assertEqual(self.r.ntag_read(4), page)
+            self.assertEqual(monitor.events(), [])
+            time.sleep(self.INTERVAL / 4)
+        self.assertEqual(self.collect(monitor, 2), [])
+        self.assertEqual(monitor.dropped, 0)
+
+    def test_close_while_waiting_for_lock(self):
+        # Keep the reader lock busy with long FAST_READs (~80ms each on the emulated RF), so that the monitor thread
+        # spends most of its time waiting for it
+        self.r.emu_place_tag("NTAG216", NFCID)
+        stop = threading.Event()
+
+        def hog():
+            while not stop.is_set():
+                try:
+                    if self.r.ntag_try_select():
+                        self.r.ntag_read_range(0, 230)
+                except RC522TagError:
+                    pass
+
+        hog_thread = threading.Thread(target=hog)
+        hog_thread.start()
+        self.addCleanup(hog_thread.join)
+        self.addCleanup(stop.set)
+
+        for close in (True, False):
+            monitors = [TagMonitor(self.r, interval=0.005)]
+            time.sleep(0.1)
+
+            def release():
+                monitor = monitors.pop()
+                if close:
+                    monitor.close()
+                # The last reference goes away here, so dealloc runs on this thread
+                del monitor
+
+            # Run on a daemon thread so that a deadlock fails the test rather than hanging the suite
+            thread = threading.Thread(target=release, daemon=True)
+            thread.start()
+            thread.join(5)
+            self.assertFalse(thread.is_alive())
+
+
+class AsyncRC522Test(unittest.TestCase):
+    def setUp(self):
+        self.r = RC522(spi_baud_rate=1_000_000, antenna_gain=4, rst_pin=25, transport="emulator")
+        self.reader = AsyncRC522(self.r)
+
+    def test_commands(self):
+        data = bytes(range(20))
+
+        async def run():
+            self.assertEqual(await self.reader.wait_for_tag(), NFCID)
+            self.assertIsNone(await self.reader.write(4, data, verify=True))
+            return await self.reader.read_range(4, 8)
+
+        self.r.emu_place_tag("NTAG215", NFCID)
+        self.assertEqual(asyncio.run(run()), data)
+
+    def test_cancel_wait_for_tag(self):
+        async def run():
+            with self.assertRaises(asyncio.TimeoutError):
+                await asyncio.wait_for(self.reader.wait_for_tag(interval=0.005), 0.1)
+            # The worker gives up on the cancelled wait, so the next commands don't queue up behind it
+            self.r.emu_place_tag("NTAG215", NFCID)
+            self.assertEqual(await asyncio.wait_for(self.reader.wait_for_tag(), 1), NFCID)
+            return await asyncio.wait_for(self.reader.read_range(0, 1), 1)
+
+        self.r.emu_remove_tag()
+        pages = asyncio.run(run())
+        # The synchronous interface isn't left locked either
+        self.assertEqual(self.r.ntag_read(0)[:8], pages)
+        self.assertEqual(pages[:3] + pages[4:], NFCID)
+
+    def test_second_loop(self):
+        async def run():
+            return await self.reader.read_range(0, 1)
+
+        self.r.emu_place_tag("NTAG215", NFCID)
+        self.assertTrue(self.r.ntag_try_select())
+        asyncio.run(run())
+        with self.assertRaises(RuntimeError):
+            asyncio.run(run())
+
+    def test_dealloc_after_loop_closed(self):
+        async def start():
+            return self.reader.wait_for_tag()
+
+        # The loop goes away with a wait in progress on the worker and no tag to end it
+        self.r.emu_remove_tag()
+        loop = asyncio.new_event_loop()
+        future = loop.run_until_complete(start())
+        time.sleep(0.05)
+        loop.close()
+        readers = [self.reader]
+        del self.reader, future, loop
+
+        # Run on a daemon thread so that a deadlock fails the test rather than hanging the suite
+        thread = threading.Thread(target=readers.pop, daemon=True)
+        thread.start()
+        thread.join(5)
+        self.assertFalse(thread.is_alive())
+        self.r.emu_place_tag("NTAG215", NFCID)
+        self.assertTrue(self.r.ntag_try_select())
+
+
+if __name__ == "__main__":
+    unittest.main()
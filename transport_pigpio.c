@@ -0,0 +1,139 @@
+#ifndef RC522C_NO_PIGPIO
+
+#include <errno.h>
+#include <pigpio.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "internal.h"
+
+// Must run as root
+// Total/free memory: vcgencmd get_mem reloc_total/reloc
+
+// pigpio is initialized once per process: readers share it, and it's terminated when the last one is closed
+static pthread_mutex_t pigpio_users_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int pigpio_users;
+
+static int pigpio_acquire(void)
+{
+    int ret = 0;
+    pthread_mutex_lock(&pigpio_users_mutex);
+    if (pigpio_users == 0)
+        ret = gpioInitialise();
+    if (ret >= 0)
+        pigpio_users++;
+    pthread_mutex_unlock(&pigpio_users_mutex);
+    return ret;
+}
+
+static void pigpio_release(void)
+{
+    pthread_mutex_lock(&pigpio_users_mutex);
+    if (--pigpio_users == 0)
+        gpioTerminate();
+    pthread_mutex_unlock(&pigpio_users_mutex);
+}
+
+static enum rc522c_status pigpio_xfer(struct rc522c_state* s, const struct rc522c_spi_xfer* xfers, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        // pigpio does not modify the tx buffer, it's just not declared const
+        char* tx = (char*)xfers[i].tx;
+        CHECK_PIGPIO(s, xfers[i].rx ? spiXfer(s->tr.pigpio.spi, tx, xfers[i].rx, xfers[i].len)
+                                    : spiWrite(s->tr.pigpio.spi, tx, xfers[i].len));
+    }
+    return RC522C_STATUS_SUCCESS;
+}
+
+static enum rc522c_status pigpio_set_rst(struct rc522c_state* s, int level)
+{
+    CHECK_PIGPIO(s, gpioWrite(s->rst_pin, level ? PI_HIGH : PI_LOW));
+    return RC522C_STATUS_SUCCESS;
+}
+
+// IRQ pin ISR, invoked from a pigpio thread
+static void pigpio_irq_isr(__attribute__((unused)) int gpio, __attribute__((unused)) int level,
+    __attribute__((unused)) uint32_t tick, void* userdata)
+{
+    struct rc522c_state* s = userdata;
+    sem_post(&s->tr.pigpio.irq_sem);
+}
+
+static void pigpio_clear_irq(struct rc522c_state* s)
+{
+    while (sem_trywait(&s->tr.pigpio.irq_sem) == 0)
+        ;
+}
+
+static int pigpio_wait_irq(struct rc522c_state* s, int timeout_us)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long)timeout_us * 1000;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000;
+    deadline.tv_nsec %= 1000000000;
+
+    while (sem_timedwait(&s->tr.pigpio.irq_sem, &deadline) != 0)
+        if (errno != EINTR)
+            return 0;
+    return 1;
+}
+
+static enum rc522c_status pigpio_set_baud_rate(struct rc522c_state* s, int baud_rate)
+{
+    // pigpio fixes the clock when the device is opened
+    spiClose(s->tr.pigpio.spi);
+    CHECK_PIGPIO(s, (s->tr.pigpio.spi = spiOpen(s->tr.pigpio.spi_channel, baud_rate, s->tr.pigpio.spi_flags)));
+    return RC522C_STATUS_SUCCESS;
+}
+
+static void pigpio_close(struct rc522c_state* s)
+{
+    if (s->irq_pin >= 0)
+    {
+        gpioSetISRFuncEx(s->irq_pin, FALLING_EDGE, 0, NULL, NULL);
+        sem_destroy(&s->tr.pigpio.irq_sem);
+    }
+    if (s->tr.pigpio.spi >= 0)
+        spiClose(s->tr.pigpio.spi);
+    pigpio_release();
+}
+
+static const struct rc522c_transport pigpio_transport = {
+    .xfer = pigpio_xfer,
+    .set_rst = pigpio_set_rst,
+    .clear_irq = pigpio_clear_irq,
+    .wait_irq = pigpio_wait_irq,
+    .set_baud_rate = pigpio_set_baud_rate,
+    .close = pigpio_close,
+};
+
+enum rc522c_status rc522c_transport_pigpio_open(struct rc522c_state* s, const struct rc522c_config* cfg)
+{
+    s->tr.pigpio.spi = -1;
+
+    CHECK_PIGPIO(s, pigpio_acquire());
+    s->transport = &pigpio_transport;
+
+    // spiOpen flags: bit 8 (A) selects the auxiliary SPI bus; mode 0 (MFRC522 8.1.2) is the default
+    s->tr.pigpio.spi_channel = cfg->spi_channel;
+    s->tr.pigpio.spi_flags = cfg->spi_aux ? (1 << 8) : 0;
+    CHECK_PIGPIO(
+        s, (s->tr.pigpio.spi = spiOpen(s->tr.pigpio.spi_channel, cfg->spi_baud_rate, s->tr.pigpio.spi_flags)));
+    CHECK_PIGPIO(s, gpioSetMode(cfg->rst_pin, PI_OUTPUT));
+
+    if (cfg->irq_pin >= 0)
+    {
+        CHECK_PIGPIO(s, gpioSetMode(cfg->irq_pin, PI_INPUT));
+        CHECK_PIGPIO(s, gpioSetPullUpDown(cfg->irq_pin, PI_PUD_UP));
+        sem_init(&s->tr.pigpio.irq_sem, 0, 0);
+        s->irq_pin = cfg->irq_pin;
+        // IRQ is active low (COM_IEN has IRqInv set)
+        CHECK_PIGPIO(s, gpioSetISRFuncEx(cfg->irq_pin, FALLING_EDGE, 0, pigpio_irq_isr, s));
+    }
+
+    return RC522C_STATUS_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <linux/spi/spidev.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "internal.h"
+
+// Linux userspace SPI (Documentation/spi/spidev) and GPIO character device (Documentation/userspace-api/gpio) access.
+// Unlike pigpio, this does not need root: membership in the groups owning /dev/spidevX.Y and /dev/gpiochipN
+// (spi and gpio on Raspberry Pi OS) is enough.
+
+static enum rc522c_status spidev_xfer(struct rc522c_state* s, const struct rc522c_spi_xfer* xfers, int n)
+{
+    struct spi_ioc_transfer tr[RC522C_SPI_BATCH_MAX];
+    memset(tr, 0, sizeof(tr[0]) * n);
+    for (int i = 0; i < n; ++i)
+    {
+        tr[i].tx_buf = (uintptr_t)xfers[i].tx;
+        tr[i].rx_buf = (uintptr_t)xfers[i].rx;
+        tr[i].len = xfers[i].len;
+        tr[i].speed_hz = s->tr.spidev.spi_speed_hz;
+        tr[i].bits_per_word = 8;
+        // MFRC522 8.1.2: each register access is delimited by NSS, so deselect the chip between transactions
+        tr[i].cs_change = i < n - 1;
+    }
+    CHECK_SYSCALL(s, ioctl(s->tr.spidev.spi_fd, SPI_IOC_MESSAGE(n), tr));
+    return RC522C_STATUS_SUCCESS;
+}
+
+static enum rc522c_status spidev_set_rst(struct rc522c_state* s, int level)
+{
+    struct gpiohandle_data data = {.values = {level ? 1 : 0}};
+    CHECK_SYSCALL(s, ioctl(s->tr.spidev.rst_fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data));
+    return RC522C_STATUS_SUCCESS;
+}
+
+static void spidev_clear_irq(struct rc522c_state* s)
+{
+    struct pollfd pfd = {.fd = s->tr.spidev.irq_fd, .events = POLLIN};
+    struct gpioevent_data event;
+    while (poll(&pfd, 1, 0) > 0)
+        if (read(s->tr.spidev.irq_fd, &event, sizeof(event)) != sizeof(event))
+            break;
+}
+
+static int spidev_wait_irq(struct rc522c_state* s, int timeout_us)
+{
+    struct pollfd pfd = {.fd = s->tr.spidev.irq_fd, .events = POLLIN};
+    int ret;
+    do
+        ret = poll(&pfd, 1, (timeout_us + 999) / 1000);
+    while (ret < 0 && errno == EINTR);
+    if (ret <= 0)
+        return 0;
+
+    struct gpioevent_data event;
+    return read(s->tr.spidev.irq_fd, &event, sizeof(event)) == sizeof(event);
+}
+
+static enum rc522c_status spidev_set_baud_rate(struct rc522c_state* s, int baud_rate)
+{
+    // Every transfer carries its own speed_hz; the device maximum has to allow it
+    uint32_t speed = baud_rate;
+    CHECK_SYSCALL(s, ioctl(s->tr.spidev.spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed));
+    s->tr.spidev.spi_speed_hz = baud_rate;
+    return RC522C_STATUS_SUCCESS;
+}
+
+static void spidev_close(struct rc522c_state* s)
+{
+    if (s->tr.spidev.irq_fd >= 0)
+        close(s->tr.spidev.irq_fd);
+    if (s->tr.spidev.rst_fd >= 0)
+        close(s->tr.spidev.rst_fd);
+    if (s->tr.spidev.spi_fd >= 0)
+        close(s->tr.spidev.spi_fd);
+}
+
+static const struct rc522c_transport spidev_transport = {
+    .xfer = spidev_xfer,
+    .set_rst = spidev_set_rst,
+    .clear_irq = spidev_clear_irq,
+    .wait_irq = spidev_wait_irq,
+    .set_baud_rate = spidev_set_baud_rate,
+    .close = spidev_close,
+};
+
+static enum rc522c_status spidev_request_lines(
+    struct rc522c_state* s, int chip_fd, const struct rc522c_config* cfg)
+{
+    struct gpiohandle_request rst_req;
+    memset(&rst_req, 0, sizeof(rst_req));
+    rst_req.lineoffsets[0] = cfg->rst_pin;
+    rst_req.lines = 1;
+    rst_req.flags = GPIOHANDLE_REQUEST_OUTPUT;
+    rst_req.default_values[0] = 1;
+    strncpy(rst_req.consumer_label, "rc522c rst", sizeof(rst_req.consumer_label) - 1);
+    CHECK_SYSCALL(s, ioctl(chip_fd, GPIO_GET_LINEHANDLE_IOCTL, &rst_req));
+    s->tr.spidev.rst_fd = rst_req.fd;
+
+    if (cfg->irq_pin >= 0)
+    {
+        struct gpioevent_request irq_req;
+        memset(&irq_req, 0, sizeof(irq_req));
+        irq_req.lineoffset = cfg->irq_pin;
+        irq_req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+        // IRQ is active low (COM_IEN has IRqInv set)
+        irq_req.eventflags = GPIOEVENT_REQUEST_FALLING_EDGE;
+        strncpy(irq_req.consumer_label, "rc522c irq", sizeof(irq_req.consumer_label) - 1);
+        CHECK_SYSCALL(s, ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &irq_req));
+        s->tr.spidev.irq_fd = irq_req.fd;
+        s->irq_pin = cfg->irq_pin;
+    }
+
+    return RC522C_STATUS_SUCCESS;
+}
+
+enum rc522c_status rc522c_transport_spidev_open(struct rc522c_state* s, const struct rc522c_config* cfg)
+{
+    s->tr.spidev.spi_fd = -1;
+    s->tr.spidev.rst_fd = -1;
+    s->tr.spidev.irq_fd = -1;
+    s->tr.spidev.spi_speed_hz = cfg->spi_baud_rate;
+    s->transport = &spidev_transport;
+
+    // The main SPI bus is spidev0, the auxiliary one is spidev1
+    char default_spi_device[32];
+    snprintf(default_spi_device, sizeof(default_spi_device), RC522C_DEFAULT_SPI_DEVICE_FORMAT, cfg->spi_aux ? 1 : 0,
+        cfg->spi_channel);
+    const char* spi_device = cfg->spi_device ? cfg->spi_device : default_spi_device;
+    CHECK_SYSCALL(s, (s->tr.spidev.spi_fd = open(spi_device, O_RDWR | O_CLOEXEC)));
+
+    // MFRC522 8.1.2: SPI mode 0, MSB first
+    uint8_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+    uint32_t speed = cfg->spi_baud_rate;
+    CHECK_SYSCALL(s, ioctl(s->tr.spidev.spi_fd, SPI_IOC_WR_MODE, &mode));
+    CHECK_SYSCALL(s, ioctl(s->tr.spidev.spi_fd, SPI_IOC_WR_BITS_PER_WORD, &bits));
+    CHECK_SYSCALL(s, ioctl(s->tr.spidev.spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed));
+
+    // Line handles stay valid after the chip is closed
+    const char* gpio_chip = cfg->gpio_chip ? cfg->gpio_chip : RC522C_DEFAULT_GPIO_CHIP;
+    int chip_fd;
+    CHECK_SYSCALL(s, (chip_fd = open(gpio_chip, O_RDWR | O_CLOEXEC)));
+    enum rc522c_status status = spidev_request_lines(s, chip_fd, cfg);
+    close(chip_fd);
+
+    return status;
+}